@@ -0,0 +1,19 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <SFML/System/Vector2.hpp>
+
+/**
+ * @brief 最近一步移动的动画状态.
+ */
+struct Animation {
+    auto active() const noexcept -> bool {
+        return progress < 1.f && direction != sf::Vector2i(0, 0);
+    }
+
+    sf::Vector2i direction = {0, 0}; // 移动方向
+    bool push = false; // 是否推动了箱子
+    float progress = 1.f; // 动画进度, 范围 [0, 1]
+};
@@ -0,0 +1,247 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 线程局部的单调分配器 (bump allocator).
+ *
+ * 依次从内存块中分配内存, 释放操作为空操作. 离开作用域时一次性回退至进入作用域
+ * 时的位置, 内存块被保留并在之后重复使用, 因此稳态下不会再调用 malloc.
+ *
+ * 通过 Arena::Scope 进入作用域, 作用域内 Arena::resource() 返回当前线程的
+ * Arena, 否则返回默认的内存资源. 作用域内分配的对象不能在作用域外使用.
+ */
+class Arena : public std::pmr::memory_resource {
+    struct Mark {
+        size_t block;
+        size_t offset;
+    };
+
+  public:
+    /**
+	 * @brief 作用域, 析构时释放作用域内分配的所有内存.
+	 */
+    class Scope {
+      public:
+        Scope() :
+            arena_(local()),
+            mark_(arena_.mark()),
+            previous_(std::exchange(current_, &arena_)) {}
+
+        ~Scope() {
+            arena_.rewind(mark_);
+            current_ = previous_;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        Arena& arena_;
+        Mark mark_;
+        Arena* previous_;
+    };
+
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param block_size 第一个内存块的大小, 之后的内存块大小依次翻倍.
+	 */
+    explicit Arena(size_t block_size = 64 * 1024) : block_size_(block_size) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+	 * @brief 获取当前线程的 Arena.
+	 */
+    static auto local() -> Arena& {
+        thread_local Arena arena;
+        return arena;
+    }
+
+    /**
+	 * @brief 获取当前作用域使用的内存资源.
+	 */
+    static auto resource() noexcept -> std::pmr::memory_resource* {
+        return current_ != nullptr ? current_
+                                   : std::pmr::get_default_resource();
+    }
+
+    /**
+	 * @brief 获取所有内存块的总大小.
+	 */
+    auto capacity() const noexcept -> size_t {
+        size_t capacity = 0;
+        for (const auto& block : blocks_) {
+            capacity += block.size;
+        }
+        return capacity;
+    }
+
+  private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    auto mark() const noexcept -> Mark {
+        return {block_, offset_};
+    }
+
+    void rewind(const Mark& mark) noexcept {
+        block_ = mark.block;
+        offset_ = mark.offset;
+    }
+
+    auto do_allocate(size_t bytes, size_t alignment) -> void* override {
+        for (;;) {
+            if (block_ < blocks_.size()) {
+                auto& block = blocks_[block_];
+                const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+                const auto address =
+                    (base + offset_ + alignment - 1) & ~(alignment - 1);
+                if (address + bytes <= base + block.size) {
+                    offset_ = address + bytes - base;
+                    return reinterpret_cast<void*>(address);
+                }
+                // 当前内存块空间不足, 使用下一个足够大的内存块
+                if (block_ + 1 < blocks_.size()
+                    && blocks_[block_ + 1].size >= bytes + alignment) {
+                    block_++;
+                    offset_ = 0;
+                    continue;
+                }
+            }
+
+            const auto position = blocks_.empty() ? 0 : block_ + 1;
+            const auto size = std::max(
+                bytes + alignment,
+                block_size_ << std::min<size_t>(blocks_.size(), 10)
+            );
+            blocks_.insert(
+                blocks_.begin() + position,
+                {std::make_unique_for_overwrite<std::byte[]>(size), size}
+            );
+            block_ = position;
+            offset_ = 0;
+        }
+    }
+
+    void do_deallocate(void*, size_t, size_t) noexcept override {}
+
+    auto do_is_equal(const std::pmr::memory_resource& other) const noexcept
+        -> bool override {
+        return this == &other;
+    }
+
+    static inline thread_local Arena* current_ = nullptr;
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    size_t block_ = 0;  // 当前内存块
+    size_t offset_ = 0; // 当前内存块中已使用的字节数
+};
+
+/**
+ * @brief 固定大小的节点池.
+ *
+ * 不超过 Size 字节的分配从空闲链表中取出, 释放时放回空闲链表, 其余分配直接交给
+ * 上游. 适用于 std::pmr 中基于节点的容器, 例如 std::pmr::unordered_set.
+ * 上游为 Arena 时, 节点池的内存随 Arena 的作用域一次性释放.
+ *
+ * @tparam Size 节点大小.
+ */
+template<size_t Size>
+class NodePool : public std::pmr::memory_resource {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param upstream 上游内存资源.
+	 */
+    explicit NodePool(
+        std::pmr::memory_resource* upstream = Arena::resource()
+    ) :
+        upstream_(upstream) {}
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool() override {
+        while (chunks_ != nullptr) {
+            auto* chunk = std::exchange(chunks_, chunks_->next);
+            upstream_->deallocate(chunk, chunk->size, alignof(Node));
+        }
+    }
+
+  private:
+    union Node {
+        Node* next;
+        alignas(std::max_align_t) std::byte data[Size];
+    };
+
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    static constexpr size_t header_size =
+        (sizeof(Chunk) + sizeof(Node) - 1) / sizeof(Node) * sizeof(Node);
+
+    auto do_allocate(size_t bytes, size_t alignment) -> void* override {
+        if (bytes > sizeof(Node) || alignment > alignof(Node)) {
+            return upstream_->allocate(bytes, alignment);
+        }
+        if (free_ == nullptr) {
+            refill();
+        }
+        return std::exchange(free_, free_->next);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        if (bytes > sizeof(Node) || alignment > alignof(Node)) {
+            upstream_->deallocate(p, bytes, alignment);
+            return;
+        }
+        auto* node = static_cast<Node*>(p);
+        node->next = free_;
+        free_ = node;
+    }
+
+    auto do_is_equal(const std::pmr::memory_resource& other) const noexcept
+        -> bool override {
+        return this == &other;
+    }
+
+    /**
+	 * @brief 从上游分配一批节点, 每批的数量依次翻倍.
+	 */
+    void refill() {
+        const auto size = header_size + sizeof(Node) * nodes_per_chunk_;
+        auto* memory =
+            static_cast<std::byte*>(upstream_->allocate(size, alignof(Node)));
+        chunks_ = new (memory) Chunk {chunks_, size};
+
+        auto* nodes = reinterpret_cast<Node*>(memory + header_size);
+        for (size_t i = 0; i < nodes_per_chunk_; i++) {
+            nodes[i].next = free_;
+            free_ = &nodes[i];
+        }
+        nodes_per_chunk_ = std::min<size_t>(nodes_per_chunk_ * 2, 4096);
+    }
+
+    std::pmr::memory_resource* upstream_;
+    Node* free_ = nullptr;
+    Chunk* chunks_ = nullptr;
+    size_t nodes_per_chunk_ = 64;
+};
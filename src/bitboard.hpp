@@ -0,0 +1,349 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#ifdef __AVX2__
+    #include <immintrin.h>
+#endif
+
+#include "arena.hpp"
+
+/**
+ * @brief 位图, 每行占用若干个 64 位整数.
+ *
+ * 宽度不超过 64 时每行恰好为一个整数, 此时可按行进行移位运算.
+ * 默认从默认的内存资源分配内存, 构造和复制得到的位图均可用作成员变量.
+ * 搜索中的临时位图可以显式地从 Arena::resource() 分配, 避免调用 malloc,
+ * 但不能比创建时的 Arena::Scope 存活更久.
+ */
+class Bitboard {
+  public:
+    Bitboard() = default;
+
+    Bitboard(
+        int width,
+        int height,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    ) :
+        width_(width),
+        height_(height),
+        words_per_row_((width + 63) / 64),
+        words_(words_per_row_ * height, 0, resource) {}
+
+    Bitboard(const Bitboard&) = default;
+
+    /**
+	 * @brief 复制位图, 并从指定的内存资源分配内存.
+	 */
+    Bitboard(const Bitboard& other, std::pmr::memory_resource* resource) :
+        width_(other.width_),
+        height_(other.height_),
+        words_per_row_(other.words_per_row_),
+        words_(other.words_, resource) {}
+
+    Bitboard(Bitboard&&) noexcept = default;
+    Bitboard& operator=(const Bitboard&) = default;
+    Bitboard& operator=(Bitboard&&) = default;
+
+    void set(int x, int y) noexcept {
+        word(x, y) |= mask(x);
+    }
+
+    void reset(int x, int y) noexcept {
+        word(x, y) &= ~mask(x);
+    }
+
+    auto test(int x, int y) const noexcept -> bool {
+        return word(x, y) & mask(x);
+    }
+
+    auto any() const noexcept -> bool {
+        return std::ranges::any_of(words_, [](auto w) { return w != 0; });
+    }
+
+    auto count() const noexcept -> int {
+        int count = 0;
+        for (const auto w : words_) {
+            count += std::popcount(w);
+        }
+        return count;
+    }
+
+    /**
+	 * @brief 获取按行优先顺序的第一个位.
+	 *
+	 * @return std::pair<int, int> 坐标, 位图为空时返回 (-1, -1).
+	 */
+    auto first() const noexcept -> std::pair<int, int> {
+        for (size_t i = 0; i < words_.size(); i++) {
+            if (words_[i] != 0) {
+                return {
+                    static_cast<int>(i % words_per_row_ * 64)
+                        + std::countr_zero(words_[i]),
+                    static_cast<int>(i / words_per_row_)
+                };
+            }
+        }
+        return {-1, -1};
+    }
+
+    /**
+	 * @brief 按行优先顺序遍历所有位.
+	 *
+	 * @param func 回调函数, 参数为坐标 (x, y).
+	 */
+    template<class F>
+    void for_each(F&& func) const {
+        for (size_t i = 0; i < words_.size(); i++) {
+            for (auto w = words_[i]; w != 0; w &= w - 1) {
+                func(
+                    static_cast<int>(i % words_per_row_ * 64)
+                        + std::countr_zero(w),
+                    static_cast<int>(i / words_per_row_)
+                );
+            }
+        }
+    }
+
+    auto operator&=(const Bitboard& rhs) noexcept -> Bitboard& {
+        assert(words_.size() == rhs.words_.size());
+        for (size_t i = 0; i < words_.size(); i++) {
+            words_[i] &= rhs.words_[i];
+        }
+        return *this;
+    }
+
+    auto operator|=(const Bitboard& rhs) noexcept -> Bitboard& {
+        assert(words_.size() == rhs.words_.size());
+        for (size_t i = 0; i < words_.size(); i++) {
+            words_[i] |= rhs.words_[i];
+        }
+        return *this;
+    }
+
+    friend auto operator&(Bitboard lhs, const Bitboard& rhs) -> Bitboard {
+        return lhs &= rhs;
+    }
+
+    friend auto operator|(Bitboard lhs, const Bitboard& rhs) -> Bitboard {
+        return lhs |= rhs;
+    }
+
+    auto operator==(const Bitboard& rhs) const noexcept -> bool = default;
+
+    /**
+	 * @brief 从种子位出发, 在空闲位中进行四连通洪水填充.
+	 *
+	 * 种子位本身总是包含在结果中, 即使其不是空闲位.
+	 *
+	 * @param seed 种子位.
+	 * @param free 空闲位.
+	 *
+	 * @return Bitboard 可达位.
+	 */
+    static auto flood_fill(Bitboard seed, const Bitboard& free) -> Bitboard {
+        assert(seed.width_ == free.width_ && seed.height_ == free.height_);
+        if (seed.words_per_row_ != 1) {
+            seed.flood_fill_generic(free);
+            return seed;
+        }
+#ifdef __AVX2__
+        if (seed.height_ >= avx2_min_height) {
+            seed.flood_fill_avx2(free);
+            return seed;
+        }
+#endif
+        seed.flood_fill_rows(free);
+        return seed;
+    }
+
+    auto width() const noexcept -> int {
+        return width_;
+    }
+
+    auto height() const noexcept -> int {
+        return height_;
+    }
+
+    auto& words() noexcept {
+        return words_;
+    }
+
+    const auto& words() const noexcept {
+        return words_;
+    }
+
+  private:
+    /**
+	 * @brief 在行内向两侧填充空闲位 (Kogge-Stone 算法).
+	 */
+    static auto fill_row(uint64_t gen, uint64_t free) noexcept -> uint64_t {
+        auto left = gen, right = gen;
+        auto left_free = free, right_free = free;
+        for (int shift = 1; shift < 64; shift *= 2) {
+            left |= left_free & (left << shift);
+            left_free &= left_free << shift;
+            right |= right_free & (right >> shift);
+            right_free &= right_free >> shift;
+        }
+        return left | right;
+    }
+
+    /**
+	 * @brief 每行为一个整数时的洪水填充, 交替进行正向和反向逐行扫描.
+	 */
+    void flood_fill_rows(const Bitboard& free) noexcept {
+        auto& rows = words_;
+        const auto& free_rows = free.words_;
+        const int height = height_;
+
+        auto update = [&](int y) {
+            const auto up = y > 0 ? rows[y - 1] : 0;
+            const auto down = y + 1 < height ? rows[y + 1] : 0;
+            const auto row =
+                fill_row(rows[y] | ((up | down) & free_rows[y]), free_rows[y]);
+            if (row == rows[y]) {
+                return false;
+            }
+            rows[y] = row;
+            return true;
+        };
+
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (int y = 0; y < height; y++) {
+                changed |= update(y);
+            }
+            for (int y = height - 1; y >= 0; y--) {
+                changed |= update(y);
+            }
+        }
+    }
+
+#ifdef __AVX2__
+    static constexpr int avx2_min_height = 16;
+
+    static auto fill_row_avx2(__m256i gen, __m256i free) noexcept -> __m256i {
+        auto left = gen, right = gen;
+        auto left_free = free, right_free = free;
+        for (int shift = 1; shift < 64; shift *= 2) {
+            const auto count = _mm_cvtsi32_si128(shift);
+            left = _mm256_or_si256(
+                left,
+                _mm256_and_si256(left_free, _mm256_sll_epi64(left, count))
+            );
+            left_free = _mm256_and_si256(
+                left_free,
+                _mm256_sll_epi64(left_free, count)
+            );
+            right = _mm256_or_si256(
+                right,
+                _mm256_and_si256(right_free, _mm256_srl_epi64(right, count))
+            );
+            right_free = _mm256_and_si256(
+                right_free,
+                _mm256_srl_epi64(right_free, count)
+            );
+        }
+        return _mm256_or_si256(left, right);
+    }
+
+    /**
+	 * @brief 每行为一个整数时的洪水填充, 每次迭代同时处理 4 行.
+	 */
+    void flood_fill_avx2(const Bitboard& free) noexcept {
+        // 首尾各留一个空行, 使上下相邻行的读取无需检查边界
+        const int height = height_;
+        const int padded_height = (height + 3) / 4 * 4;
+        const auto resource = Arena::resource();
+        std::pmr::vector<uint64_t> current(padded_height + 2, 0, resource);
+        std::pmr::vector<uint64_t> next(padded_height + 2, 0, resource);
+        std::pmr::vector<uint64_t> free_rows(padded_height, 0, resource);
+        std::ranges::copy(words_, current.begin() + 1);
+        std::ranges::copy(free.words_, free_rows.begin());
+
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (int y = 0; y < padded_height; y += 4) {
+                const auto* row = current.data() + 1 + y;
+                const auto cur = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(row)
+                );
+                const auto up = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(row - 1)
+                );
+                const auto down = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(row + 1)
+                );
+                const auto fr = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(free_rows.data() + y)
+                );
+                const auto gen = _mm256_or_si256(
+                    cur,
+                    _mm256_and_si256(_mm256_or_si256(up, down), fr)
+                );
+                const auto result = fill_row_avx2(gen, fr);
+                _mm256_storeu_si256(
+                    reinterpret_cast<__m256i*>(next.data() + 1 + y),
+                    result
+                );
+                const auto diff = _mm256_xor_si256(result, cur);
+                changed |= !_mm256_testz_si256(diff, diff);
+            }
+            std::swap(current, next);
+        }
+        std::copy_n(current.begin() + 1, height, words_.begin());
+    }
+#endif
+
+    /**
+	 * @brief 任意宽度的洪水填充.
+	 */
+    void flood_fill_generic(const Bitboard& free) {
+        std::pmr::vector<std::pair<int, int>> stack(Arena::resource());
+        for_each([&](int x, int y) { stack.emplace_back(x, y); });
+        while (!stack.empty()) {
+            const auto [x, y] = stack.back();
+            stack.pop_back();
+            const std::pair<int, int> neighbors[] =
+                {{x, y - 1}, {x, y + 1}, {x - 1, y}, {x + 1, y}};
+            for (const auto& [nx, ny] : neighbors) {
+                if (nx < 0 || nx >= width_ || ny < 0 || ny >= height_) {
+                    continue;
+                }
+                if (free.test(nx, ny) && !test(nx, ny)) {
+                    set(nx, ny);
+                    stack.emplace_back(nx, ny);
+                }
+            }
+        }
+    }
+
+    static auto mask(int x) noexcept -> uint64_t {
+        return uint64_t(1) << (x % 64);
+    }
+
+    auto word(int x, int y) noexcept -> uint64_t& {
+        assert(x >= 0 && x < width_ && y >= 0 && y < height_);
+        return words_[y * words_per_row_ + x / 64];
+    }
+
+    auto word(int x, int y) const noexcept -> uint64_t {
+        assert(x >= 0 && x < width_ && y >= 0 && y < height_);
+        return words_[y * words_per_row_ + x / 64];
+    }
+
+    int width_ = 0;
+    int height_ = 0;
+    int words_per_row_ = 0;
+    std::pmr::vector<uint64_t> words_;
+};
@@ -0,0 +1,571 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include "arena.hpp"
+#include "bitboard.hpp"
+#include "crc32.hpp"
+#include "level.hpp"
+#include "tile.hpp"
+
+/**
+ * @brief 求解器使用的静态地图信息.
+ *
+ * 坐标与含边框的关卡地图一致, 格子以索引 y * stride + x 表示. 方向按上下左右
+ * 的顺序编号, 与 LURD 格式移动 "udlr" 对应.
+ */
+class Board {
+  public:
+    static constexpr uint16_t unreachable =
+        std::numeric_limits<uint16_t>::max();
+    static constexpr std::array<char, 4> moves = {'u', 'd', 'l', 'r'};
+
+    /**
+	 * @brief 一次推动.
+	 */
+    struct Push {
+        int crate;     // 推动前的箱子位置
+        int direction; // 推动方向
+    };
+
+    /**
+	 * @brief 目标房间, 即仅通过一个入口与地图其余部分相连且包含目标点的区域.
+	 *
+	 * 房间内的目标点按固定顺序填充, 箱子到达入口后可以通过预先计算的推动序列
+	 * 直接推至下一个需要填充的目标点.
+	 */
+    struct GoalRoom {
+        int entrance;                         // 入口, 为关节点
+        int direction;                        // 箱子经入口进入房间的方向
+        std::vector<bool> cells;              // 房间内的格子, 不含入口
+        std::vector<int> order;               // 目标点的填充顺序
+        std::vector<std::vector<Push>> paths; // 将箱子从入口推至各目标点
+    };
+
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param level 未旋转的关卡.
+	 */
+    explicit Board(const Level& level) :
+        stride_(level.size().x + 2), height_(level.size().y + 2) {
+        assert(level.rotation() == 0);
+        offsets_ = {-stride_, stride_, -1, 1};
+
+        const auto& map = level.map();
+        tiles_.resize(map.size());
+        floor_ = Bitboard(stride_, height_);
+        for (int i = 0; i < cells(); i++) {
+            tiles_[i] = map[i] & (Tile::Floor | Tile::Wall | Tile::Target);
+            if (tiles_[i] & Tile::Floor) {
+                floor_.set(i % stride_, i / stride_);
+                if (tiles_[i] & Tile::Target) {
+                    targets_.push_back(i);
+                }
+            }
+        }
+        fingerprint_ = ::crc32(0, tiles_.data(), tiles_.size());
+
+        min_distances_.assign(cells(), unreachable);
+        for (const auto target : targets_) {
+            distances_.push_back(pull_distances(target));
+            for (int i = 0; i < cells(); i++) {
+                min_distances_[i] =
+                    std::min(min_distances_[i], distances_.back()[i]);
+            }
+        }
+
+        analyze_tunnels();
+        analyze_articulations();
+        analyze_goal_rooms();
+    }
+
+    /**
+	 * @brief 获取含边框的地图宽度.
+	 */
+    auto stride() const noexcept -> int {
+        return stride_;
+    }
+
+    /**
+	 * @brief 获取含边框的地图高度.
+	 */
+    auto height() const noexcept -> int {
+        return height_;
+    }
+
+    /**
+	 * @brief 获取格子数量.
+	 */
+    auto cells() const noexcept -> int {
+        return stride_ * height_;
+    }
+
+    /**
+	 * @brief 获取方向对应的索引偏移.
+	 */
+    auto offset(int direction) const noexcept -> int {
+        return offsets_[direction];
+    }
+
+    /**
+	 * @brief 是否为角色可以到达的地板.
+	 */
+    auto is_floor(int cell) const noexcept -> bool {
+        return tiles_[cell] & Tile::Floor;
+    }
+
+    auto is_target(int cell) const noexcept -> bool {
+        return tiles_[cell] & Tile::Target;
+    }
+
+    /**
+	 * @brief 获取不含箱子和角色的图块.
+	 */
+    auto tile(int cell) const noexcept -> uint8_t {
+        return tiles_[cell];
+    }
+
+    const auto& targets() const noexcept {
+        return targets_;
+    }
+
+    /**
+	 * @brief 获取在忽略其他箱子时, 将箱子推至指定目标点所需的最少推动次数.
+	 *
+	 * @param target 目标点在 targets() 中的序号.
+	 * @param cell   箱子位置.
+	 *
+	 * @return 推动次数, 无法到达时为 unreachable.
+	 */
+    auto distance(size_t target, int cell) const noexcept -> uint16_t {
+        return distances_[target][cell];
+    }
+
+    /**
+	 * @brief 获取在忽略其他箱子时, 将箱子推至任意目标点所需的最少推动次数.
+	 */
+    auto min_distance(int cell) const noexcept -> uint16_t {
+        return min_distances_[cell];
+    }
+
+    /**
+	 * @brief 是否为死角, 即位于此处的箱子无法被推至任何目标点.
+	 */
+    auto is_dead(int cell) const noexcept -> bool {
+        return min_distances_[cell] == unreachable;
+    }
+
+    /**
+	 * @brief 获取静态地图的指纹, 用于校验缓存的数据.
+	 */
+    auto fingerprint() const noexcept -> uint32_t {
+        return fingerprint_;
+    }
+
+    /**
+	 * @brief 生成箱子位图.
+	 */
+    template<class Range>
+    auto plane(const Range& crates) const -> Bitboard {
+        Bitboard plane(stride_, height_, Arena::resource());
+        for (const int crate : crates) {
+            plane.set(crate % stride_, crate / stride_);
+        }
+        return plane;
+    }
+
+    /**
+	 * @brief 计算角色可到达的区域.
+	 *
+	 * @param player 角色位置.
+	 * @param crates 箱子位图.
+	 */
+    auto reachable(int player, const Bitboard& crates) const -> Bitboard {
+        Bitboard free(floor_, Arena::resource());
+        auto& words = free.words();
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] &= ~crates.words()[i];
+        }
+        Bitboard seed(stride_, height_, Arena::resource());
+        seed.set(player % stride_, player / stride_);
+        return Bitboard::flood_fill(std::move(seed), free);
+    }
+
+    /**
+	 * @brief 判断格子是否位于区域中.
+	 */
+    auto contains(const Bitboard& area, int cell) const noexcept -> bool {
+        return area.test(cell % stride_, cell / stride_);
+    }
+
+    /**
+	 * @brief 获取区域中索引最小的格子, 用作角色位置的规范化表示.
+	 */
+    auto normalize(const Bitboard& area) const noexcept -> int {
+        const auto [x, y] = area.first();
+        return y * stride_ + x;
+    }
+
+    /**
+	 * @brief 将角色可位于的地板划分为互不连通的区域.
+	 *
+	 * @param crates 箱子位图.
+	 */
+    auto regions(const Bitboard& crates) const
+        -> std::pmr::vector<Bitboard> {
+        std::pmr::vector<Bitboard> regions(Arena::resource());
+        std::pmr::vector<bool> covered(cells(), false, Arena::resource());
+        for (int i = 0; i < cells(); i++) {
+            if (!is_floor(i) || contains(crates, i) || covered[i]) {
+                continue;
+            }
+            regions.push_back(reachable(i, crates));
+            regions.back().for_each([&](int x, int y) {
+                covered[y * stride_ + x] = true;
+            });
+        }
+        return regions;
+    }
+
+    /**
+	 * @brief 从指定位置出发拉动箱子, 计算将箱子推至该位置所需的推动次数.
+	 *
+	 * 忽略其他箱子和角色的可达性.
+	 *
+	 * @param cell 箱子的终点.
+	 */
+    auto pull_distances(int cell) const -> std::vector<uint16_t> {
+        // 拉动时角色位于箱子前进方向的一侧, 并继续后退一格
+        return distances(cell, 2);
+    }
+
+    /**
+	 * @brief 从指定位置出发推动箱子, 计算将箱子从该位置推至各处所需的推动次数.
+	 *
+	 * 忽略其他箱子和角色的可达性.
+	 *
+	 * @param cell 箱子的起点.
+	 */
+    auto push_distances(int cell) const -> std::vector<uint16_t> {
+        // 推动时角色位于箱子后方
+        return distances(cell, -1);
+    }
+
+    /**
+	 * @brief 是否为隧道, 即沿指定方向推动箱子时两侧均不可通行.
+	 */
+    auto is_tunnel(int cell, int direction) const noexcept -> bool {
+        return tunnels_[cell] & (1 << direction / 2);
+    }
+
+    /**
+	 * @brief 是否为关节点, 即移除后会使地板不再连通的格子.
+	 */
+    auto is_articulation(int cell) const noexcept -> bool {
+        return articulations_[cell];
+    }
+
+    const auto& goal_rooms() const noexcept {
+        return goal_rooms_;
+    }
+
+    /**
+	 * @brief 获取箱子沿指定方向被推至入口时进入的目标房间.
+	 *
+	 * @return 目标房间, 不存在时返回 nullptr.
+	 */
+    auto goal_room(int entrance, int direction) const noexcept
+        -> const GoalRoom* {
+        const auto index = goal_room_indices_[entrance * 4 + direction];
+        return index == -1 ? nullptr : &goal_rooms_[index];
+    }
+
+  private:
+    /**
+	 * @brief 标记隧道.
+	 */
+    void analyze_tunnels() {
+        tunnels_.assign(cells(), 0);
+        for (int i = 0; i < cells(); i++) {
+            if (!is_floor(i)) {
+                continue;
+            }
+            // 方向 0, 1 为纵向, 2, 3 为横向
+            if (!is_floor(i - 1) && !is_floor(i + 1)) {
+                tunnels_[i] |= 1 << 0;
+            }
+            if (!is_floor(i - stride_) && !is_floor(i + stride_)) {
+                tunnels_[i] |= 1 << 1;
+            }
+        }
+    }
+
+    /**
+	 * @brief 使用 Tarjan 算法标记地板中的关节点.
+	 */
+    void analyze_articulations() {
+        articulations_.assign(cells(), false);
+        std::vector<int> discovery(cells(), -1), low(cells());
+        int time = 0;
+
+        struct Frame {
+            int cell;
+            int parent;
+            int direction; // 下一个待访问的方向
+            int children;
+        };
+        std::vector<Frame> stack;
+        for (int root = 0; root < cells(); root++) {
+            if (!is_floor(root) || discovery[root] != -1) {
+                continue;
+            }
+            discovery[root] = low[root] = time++;
+            stack.push_back({root, -1, 0, 0});
+            while (!stack.empty()) {
+                auto& frame = stack.back();
+                if (frame.direction == 4) {
+                    const auto [cell, parent, direction, children] = frame;
+                    stack.pop_back();
+                    if (parent == -1) {
+                        articulations_[cell] = children > 1;
+                        continue;
+                    }
+                    low[parent] = std::min(low[parent], low[cell]);
+                    if (stack.back().parent != -1
+                        && low[cell] >= discovery[parent]) {
+                        articulations_[parent] = true;
+                    }
+                    continue;
+                }
+
+                const auto next = frame.cell + offsets_[frame.direction++];
+                if (!is_floor(next)) {
+                    continue;
+                }
+                if (discovery[next] == -1) {
+                    frame.children++;
+                    discovery[next] = low[next] = time++;
+                    stack.push_back({next, frame.cell, 0, 0});
+                } else if (next != frame.parent) {
+                    low[frame.cell] =
+                        std::min(low[frame.cell], discovery[next]);
+                }
+            }
+        }
+    }
+
+    /**
+	 * @brief 查找目标房间, 并计算其目标点的填充顺序.
+	 */
+    void analyze_goal_rooms() {
+        goal_room_indices_.assign(cells() * 4, -1);
+        for (int entrance = 0; entrance < cells(); entrance++) {
+            if (!articulations_[entrance] || is_target(entrance)) {
+                continue;
+            }
+            for (int direction = 0; direction < 4; direction++) {
+                const auto offset = offsets_[direction];
+                if (!is_floor(entrance - offset)
+                    || !is_floor(entrance + offset)) {
+                    continue;
+                }
+
+                // 移除入口后与入口外侧不连通的区域即为房间
+                auto free = floor_;
+                free.reset(entrance % stride_, entrance / stride_);
+                Bitboard seed(stride_, height_);
+                seed.set(
+                    (entrance + offset) % stride_,
+                    (entrance + offset) / stride_
+                );
+                const auto area = Bitboard::flood_fill(seed, free);
+                if (contains(area, entrance - offset)) {
+                    continue;
+                }
+
+                GoalRoom room {
+                    entrance, direction, std::vector<bool>(cells()), {}, {}
+                };
+                std::vector<int> remaining;
+                area.for_each([&](int x, int y) {
+                    room.cells[y * stride_ + x] = true;
+                    if (is_target(y * stride_ + x)) {
+                        remaining.push_back(y * stride_ + x);
+                    }
+                });
+                if (remaining.empty() || !order_goal_room(room, remaining)) {
+                    continue;
+                }
+                goal_room_indices_[entrance * 4 + direction] =
+                    static_cast<int>(goal_rooms_.size());
+                goal_rooms_.push_back(std::move(room));
+            }
+        }
+    }
+
+    /**
+	 * @brief 计算目标房间的填充顺序.
+	 *
+	 * 从所有目标点都已填充的状态出发, 反复找出在其余目标点均已填充时仍能被
+	 * 填充的目标点, 该目标点即为剩余目标点中最后填充的.
+	 *
+	 * @return 是否所有目标点都能按顺序填充.
+	 */
+    auto order_goal_room(GoalRoom& room, std::vector<int> remaining) const
+        -> bool {
+        std::vector<int> order;
+        std::vector<std::vector<Push>> paths;
+        while (!remaining.empty()) {
+            bool found = false;
+            for (size_t i = 0; i < remaining.size() && !found; i++) {
+                auto filled = remaining;
+                filled.erase(filled.begin() + i);
+                auto path = room_path(room, filled, remaining[i]);
+                if (path.has_value()) {
+                    order.push_back(remaining[i]);
+                    paths.push_back(std::move(*path));
+                    remaining = std::move(filled);
+                    found = true;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        room.order.assign(order.rbegin(), order.rend());
+        room.paths.assign(paths.rbegin(), paths.rend());
+        return true;
+    }
+
+    /**
+	 * @brief 计算将位于房间入口的箱子推至目标点的推动序列.
+	 *
+	 * 角色位于入口外侧, 推动过程中仅能在房间和入口内活动.
+	 *
+	 * @param room   目标房间.
+	 * @param filled 房间内已被箱子占据的目标点.
+	 * @param target 目标点.
+	 */
+    auto room_path(
+        const GoalRoom& room,
+        const std::vector<int>& filled,
+        int target
+    ) const -> std::optional<std::vector<Push>> {
+        Bitboard free(stride_, height_);
+        for (int i = 0; i < cells(); i++) {
+            if (room.cells[i] || i == room.entrance) {
+                free.set(i % stride_, i / stride_);
+            }
+        }
+        for (const auto cell : filled) {
+            free.reset(cell % stride_, cell / stride_);
+        }
+
+        // 第一次推动使箱子进入房间
+        const auto first = room.entrance + offsets_[room.direction];
+        if (!contains(free, first)) {
+            return std::nullopt;
+        }
+
+        struct Node {
+            int crate;
+            int player;
+            int parent;
+            Push push;
+        };
+        std::vector<Node> nodes = {
+            {first, room.entrance, -1, {room.entrance, room.direction}}
+        };
+        std::unordered_set<int64_t> visited;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const auto [crate, player, parent, push] = nodes[i];
+            if (crate == target) {
+                std::vector<Push> path;
+                for (auto j = static_cast<int>(i); j != -1;
+                     j = nodes[j].parent) {
+                    path.push_back(nodes[j].push);
+                }
+                std::reverse(path.begin(), path.end());
+                return path;
+            }
+
+            auto space = free;
+            space.reset(crate % stride_, crate / stride_);
+            Bitboard seed(stride_, height_);
+            seed.set(player % stride_, player / stride_);
+            const auto area = Bitboard::flood_fill(std::move(seed), space);
+            if (!visited.insert(int64_t(crate) * cells() + normalize(area))
+                     .second) {
+                continue;
+            }
+            for (int direction = 0; direction < 4; direction++) {
+                const auto offset = offsets_[direction];
+                if (contains(area, crate - offset)
+                    && contains(space, crate + offset)) {
+                    nodes.push_back(
+                        {crate + offset,
+                         crate,
+                         static_cast<int>(i),
+                         {crate, direction}}
+                    );
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+	 * @brief 箱子移动的广度优先搜索.
+	 *
+	 * @param cell   起点.
+	 * @param player 角色需占用的格子相对于箱子的位置, 以方向的倍数表示.
+	 */
+    auto distances(int cell, int player) const -> std::vector<uint16_t> {
+        std::vector<uint16_t> distances(cells(), unreachable);
+        std::queue<int> queue;
+        distances[cell] = 0;
+        queue.push(cell);
+        while (!queue.empty()) {
+            const auto crate = queue.front();
+            queue.pop();
+            for (const auto offset : offsets_) {
+                const auto next = crate + offset;
+                if (!is_floor(next) || !is_floor(crate + offset * player)
+                    || distances[next] != unreachable) {
+                    continue;
+                }
+                distances[next] = distances[crate] + 1;
+                queue.push(next);
+            }
+        }
+        return distances;
+    }
+
+    int stride_;
+    int height_;
+    std::array<int, 4> offsets_;
+    std::vector<uint8_t> tiles_;
+    Bitboard floor_;
+    std::vector<int> targets_;
+    uint32_t fingerprint_ = 0;
+
+    std::vector<std::vector<uint16_t>> distances_;
+    std::vector<uint16_t> min_distances_;
+
+    std::vector<uint8_t> tunnels_; // 第 0 位为纵向隧道, 第 1 位为横向隧道
+    std::vector<bool> articulations_;
+    std::vector<GoalRoom> goal_rooms_;
+    std::vector<int> goal_room_indices_; // 按入口和方向索引
+};
@@ -4,17 +4,38 @@
 #pragma once
 
 #include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Transaction.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdint>
 #include <filesystem>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "crc32.hpp"
 #include "level.hpp"
+#include "movement_codec.hpp"
+#include "solution_cache.hpp"
 
 class Database {
   public:
+    /**
+	 * @brief 比较答案时优先考虑的指标.
+	 */
+    enum class Metric {
+        Moves,  // 移动次数优先
+        Pushes, // 推动次数优先
+    };
+
     Database(const std::filesystem::path& path) :
         database_(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) {
+        // 提示引擎在后台线程中使用另一个连接, 写入冲突时等待而不是失败
+        database_.setBusyTimeout(1000);
         setup();
     }
 
@@ -29,25 +50,68 @@ class Database {
             "	author   TEXT,"
             "	map      TEXT NOT NULL,"
             "	crc32    INTEGER NOT NULL,"
-            "	solution TEXT,"
-            "	date     DATE NOT NULL"
+            "	solution BLOB,"
+            "	moves    INTEGER,"
+            "	pushes   INTEGER,"
+            "	date     DATE NOT NULL,"
+            "	pdb      BLOB"
             ")"
         );
+        add_column_if_missing("tb_level", "pdb", "BLOB");
+        add_column_if_missing("tb_level", "moves", "INTEGER");
+        add_column_if_missing("tb_level", "pushes", "INTEGER");
         database_.exec(
             "CREATE TABLE IF NOT EXISTS tb_session ("
             "	level_id INTEGER UNIQUE,"
-            "	movement TEXT,"
+            "	movement BLOB,"
             "	datetime DATETIME NOT NULL,"
             "	FOREIGN KEY (level_id) REFERENCES tb_level(id)"
             ")"
         );
+        migrate_solution_cache();
+        database_.exec(
+            "CREATE TABLE IF NOT EXISTS tb_solution_cache ("
+            "	hash     INTEGER PRIMARY KEY,"
+            "	pushes   INTEGER NOT NULL,"
+            "	bound    INTEGER NOT NULL,"
+            "	solution BLOB NOT NULL"
+            ")"
+        );
+        // 每个关卡的 Pareto 最优答案, 即不存在移动和推动次数都不多于它的答案.
+        // 唯一约束和索引分别按移动次数优先和推动次数优先排列
+        database_.exec(
+            "CREATE TABLE IF NOT EXISTS tb_solution ("
+            "	level_id INTEGER NOT NULL,"
+            "	moves    INTEGER NOT NULL,"
+            "	pushes   INTEGER NOT NULL,"
+            "	solution BLOB NOT NULL,"
+            "	date     DATE NOT NULL,"
+            "	UNIQUE (level_id, moves, pushes),"
+            "	FOREIGN KEY (level_id) REFERENCES tb_level(id)"
+            ")"
+        );
+        database_.exec(
+            "CREATE INDEX IF NOT EXISTS idx_solution_pushes "
+            "ON tb_solution(level_id, pushes, moves)"
+        );
+        database_.exec(
+            "CREATE INDEX IF NOT EXISTS idx_level_moves "
+            "ON tb_level(moves, pushes)"
+        );
+        database_.exec(
+            "CREATE INDEX IF NOT EXISTS idx_level_unsolved "
+            "ON tb_level(id) WHERE solution IS NULL"
+        );
+        migrate_solution_metrics();
     }
 
     /**
 	 * @brief 重置数据库.
 	 */
     void reset() {
-        database_.exec("DROP TABLE IF EXISTS tb_level, tb_session");
+        for (const auto table :
+             {"tb_solution", "tb_session", "tb_solution_cache", "tb_level"})
+            database_.exec(std::string("DROP TABLE IF EXISTS ") + table);
         setup();
     }
 
@@ -132,33 +196,98 @@ class Database {
             data +=
                 "Author: " + query_level.getColumn("author").getString() + '\n';
         if (!query_level.getColumn("solution").isNull())
-            data += "Solution: " + query_level.getColumn("solution").getString()
-                + '\n';
+            data += "Solution: "
+                  + read_movement(query_level.getColumn("solution")) + '\n';
         data += query_level.getColumn("map").getString();
         return Level(data);
     }
 
+    /**
+	 * @brief 获取关卡的指纹, 关卡的地图或答案改变时指纹随之改变.
+	 *
+	 * @param id 关卡 ID.
+	 */
+    auto get_level_fingerprint(int id) -> std::optional<uint64_t> {
+        // 每次切换关卡时调用, 复用预编译的语句, 语句不能被多个线程同时使用
+        std::lock_guard lock(fingerprint_mutex_);
+        if (!query_fingerprint_.has_value())
+            query_fingerprint_.emplace(
+                database_,
+                "SELECT crc32, moves, pushes FROM tb_level "
+                "WHERE id = ?"
+            );
+        auto& query_fingerprint = query_fingerprint_.value();
+        query_fingerprint.bind(1, id);
+        if (!query_fingerprint.executeStep()) {
+            query_fingerprint.reset();
+            return std::nullopt;
+        }
+        // 地图的 CRC32 和最优答案的移动, 推动次数, 没有答案时均为 0
+        const auto map_crc32 =
+            query_fingerprint.getColumn("crc32").getInt64();
+        const int32_t metrics[] = {
+            query_fingerprint.getColumn("moves").getInt(),
+            query_fingerprint.getColumn("pushes").getInt()
+        };
+        query_fingerprint.reset();
+        // 高 32 位为地图的 CRC32, 低 32 位为移动和推动次数的 CRC32.
+        // CRC32 能检出不超过 32 位的突发错误, 因此仅其中一项变化时指纹必然改变
+        return static_cast<uint64_t>(map_crc32) << 32
+             | crc32(0, metrics, sizeof(metrics));
+    }
+
+    /**
+	 * @brief 获取之后第一个没有答案的关卡 ID.
+	 *
+	 * @param id 关卡 ID.
+	 */
+    auto get_next_unsolved_level_id(int id) -> std::optional<int> {
+        SQLite::Statement query_id(
+            database_,
+            "SELECT id FROM tb_level "
+            "WHERE id > ? AND solution IS NULL "
+            "ORDER BY id "
+            "LIMIT 1"
+        );
+        query_id.bind(1, id);
+        if (!query_id.executeStep())
+            return std::nullopt;
+        return query_id.getColumn("id");
+    }
+
+    /**
+	 * @brief 获取所有已有答案的关卡 ID.
+	 */
+    auto get_solved_level_ids() -> std::vector<int> {
+        SQLite::Statement query_ids(
+            database_,
+            "SELECT id FROM tb_level "
+            "WHERE solution IS NOT NULL "
+            "ORDER BY id"
+        );
+        std::vector<int> ids;
+        while (query_ids.executeStep())
+            ids.push_back(query_ids.getColumn("id"));
+        return ids;
+    }
+
     /**
 	 * @brief 更新关卡答案.
 	 *
+	 * 答案在移动和推动次数上不劣于已有答案时被记录. 关卡的答案为移动次数最少,
+	 * 其次推动次数最少的答案.
+	 *
 	 * @param level_id 关卡 ID.
-	 * @param solution 关卡答案.
+	 * @param solution 已验证的关卡答案.
+	 *
+	 * @return 答案是否被记录.
 	 */
     auto
     update_level_solution(int level_id, const std::string& solution) -> bool {
-        SQLite::Statement update_solution(
-            database_,
-            "UPDATE tb_level "
-            "SET solution = ? "
-            "WHERE id = ? AND EXISTS ("
-            "	SELECT * FROM tb_level WHERE id = ? AND (solution IS NULL OR LENGTH(solution) > LENGTH(?))"
-            ")"
-        );
-        update_solution.bind(1, solution);
-        update_solution.bind(2, level_id);
-        update_solution.bind(3, level_id);
-        update_solution.bind(4, solution);
-        return update_solution.exec();
+        SQLite::Transaction transaction(database_);
+        const auto updated = insert_solution(level_id, solution);
+        transaction.commit();
+        return updated;
     }
 
     /**
@@ -174,6 +303,31 @@ class Database {
         );
     }
 
+    /**
+	 * @brief 获取关卡的最优答案.
+	 *
+	 * @param level_id 关卡 ID.
+	 * @param metric   优先考虑的指标.
+	 */
+    auto get_best_solution(int level_id, Metric metric = Metric::Moves)
+        -> std::optional<std::string> {
+        SQLite::Statement query_solution(
+            database_,
+            metric == Metric::Moves ? "SELECT solution FROM tb_solution "
+                                      "WHERE level_id = ? "
+                                      "ORDER BY moves, pushes "
+                                      "LIMIT 1"
+                                    : "SELECT solution FROM tb_solution "
+                                      "WHERE level_id = ? "
+                                      "ORDER BY pushes, moves "
+                                      "LIMIT 1"
+        );
+        query_solution.bind(1, level_id);
+        if (!query_solution.executeStep())
+            return std::nullopt;
+        return read_movement(query_solution.getColumn("solution"));
+    }
+
     /**
 	 * @brief 更新关卡会话移动.
 	 *
@@ -181,15 +335,7 @@ class Database {
 	 */
     auto
     update_session_movement(int level_id, const std::string& movement) -> bool {
-        SQLite::Statement update_movements(
-            database_,
-            "UPDATE tb_session "
-            "SET movement = ? "
-            "WHERE level_id = ?"
-        );
-        update_movements.bind(1, movement);
-        update_movements.bind(2, level_id);
-        return update_movements.exec();
+        return update_session_movement(level_id, encode_movement(movement));
     }
 
     /**
@@ -200,7 +346,7 @@ class Database {
     auto update_session_movement(const Level& level) -> bool {
         return update_session_movement(
             get_level_id(level).value(),
-            level.movement()
+            encode_movement(level.history())
         );
     }
 
@@ -258,9 +404,275 @@ class Database {
         query_movements.bind(1, get_level_id(level).value());
         if (!query_movements.executeStep())
             return "";
-        return query_movements.getColumn(0);
+        return read_movement(query_movements.getColumn(0));
+    }
+
+    /**
+	 * @brief 获取缓存的模式数据库.
+	 *
+	 * @param level 关卡.
+	 */
+    auto get_pattern_database(const Level& level)
+        -> std::optional<std::vector<uint8_t>> {
+        SQLite::Statement query_pdb(
+            database_,
+            "SELECT pdb FROM tb_level "
+            "WHERE crc32 = ?"
+        );
+        query_pdb.bind(1, level.crc32());
+        if (!query_pdb.executeStep() || query_pdb.getColumn("pdb").isNull())
+            return std::nullopt;
+        const auto column = query_pdb.getColumn("pdb");
+        const auto data = static_cast<const uint8_t*>(column.getBlob());
+        return std::vector<uint8_t>(data, data + column.getBytes());
+    }
+
+    /**
+	 * @brief 缓存模式数据库.
+	 *
+	 * @param level 关卡.
+	 * @param data  序列化的模式数据库.
+	 */
+    auto update_pattern_database(
+        const Level& level,
+        const std::vector<uint8_t>& data
+    ) -> bool {
+        SQLite::Statement update_pdb(
+            database_,
+            "UPDATE tb_level "
+            "SET pdb = ? "
+            "WHERE crc32 = ?"
+        );
+        update_pdb.bind(1, data.data(), static_cast<int>(data.size()));
+        update_pdb.bind(2, level.crc32());
+        return update_pdb.exec();
+    }
+
+    /**
+	 * @brief 查询解缓存.
+	 *
+	 * @param hash 局面的规范哈希值.
+	 */
+    auto get_cached_solution(uint64_t hash) -> std::optional<CachedSolution> {
+        SQLite::Statement query_solution(
+            database_,
+            "SELECT pushes, bound, solution FROM tb_solution_cache "
+            "WHERE hash = ?"
+        );
+        query_solution.bind(1, static_cast<int64_t>(hash));
+        if (!query_solution.executeStep())
+            return std::nullopt;
+        const auto column = query_solution.getColumn("solution");
+        const auto data = static_cast<const uint8_t*>(column.getBlob());
+        return CachedSolution {
+            hash,
+            query_solution.getColumn("pushes").getInt(),
+            query_solution.getColumn("bound").getInt(),
+            std::vector<uint8_t>(data, data + column.getBytes())
+        };
+    }
+
+    /**
+	 * @brief 更新解缓存.
+	 *
+	 * 局面已存在时保留推动次数较少的解和较大的下界.
+	 *
+	 * @param entries 条目.
+	 */
+    void update_solution_cache(const std::vector<CachedSolution>& entries) {
+        SQLite::Transaction transaction(database_);
+        SQLite::Statement upsert_solution(
+            database_,
+            "INSERT INTO tb_solution_cache(hash, pushes, bound, solution) "
+            "VALUES (?, ?, ?, ?) "
+            "ON CONFLICT(hash) DO UPDATE SET "
+            "	solution = CASE WHEN excluded.pushes < pushes "
+            "	           THEN excluded.solution ELSE solution END,"
+            "	pushes = MIN(pushes, excluded.pushes),"
+            "	bound = MAX(bound, excluded.bound)"
+        );
+        for (const auto& entry : entries) {
+            upsert_solution.bind(1, static_cast<int64_t>(entry.key));
+            upsert_solution.bind(2, entry.pushes);
+            upsert_solution.bind(3, entry.bound);
+            upsert_solution.bind(
+                4,
+                entry.data.data(),
+                static_cast<int>(entry.data.size())
+            );
+            upsert_solution.exec();
+            upsert_solution.reset();
+        }
+        transaction.commit();
     }
 
   private:
+    /**
+	 * @brief 记录关卡答案, 须在事务中调用.
+	 *
+	 * @return 答案是否被记录.
+	 */
+    auto insert_solution(int level_id, const std::string& solution) -> bool {
+        const auto data = encode_movement(solution);
+        const auto moves = static_cast<int>(solution.size());
+        const auto pushes = static_cast<int>(
+            std::ranges::count_if(solution, [](auto c) {
+                return std::isupper(c);
+            })
+        );
+
+        SQLite::Statement query_dominating(
+            database_,
+            "SELECT 1 FROM tb_solution "
+            "WHERE level_id = ? AND moves <= ? AND pushes <= ? "
+            "LIMIT 1"
+        );
+        query_dominating.bind(1, level_id);
+        query_dominating.bind(2, moves);
+        query_dominating.bind(3, pushes);
+        if (query_dominating.executeStep())
+            return false;
+
+        SQLite::Statement delete_dominated(
+            database_,
+            "DELETE FROM tb_solution "
+            "WHERE level_id = ? AND moves >= ? AND pushes >= ?"
+        );
+        delete_dominated.bind(1, level_id);
+        delete_dominated.bind(2, moves);
+        delete_dominated.bind(3, pushes);
+        delete_dominated.exec();
+
+        SQLite::Statement insert_solution(
+            database_,
+            "INSERT INTO tb_solution(level_id, moves, pushes, solution, date) "
+            "VALUES (?, ?, ?, ?, DATE('now'))"
+        );
+        insert_solution.bind(1, level_id);
+        insert_solution.bind(2, moves);
+        insert_solution.bind(3, pushes);
+        insert_solution.bind(4, data.data(), static_cast<int>(data.size()));
+        insert_solution.exec();
+
+        SQLite::Statement update_solution(
+            database_,
+            "UPDATE tb_level "
+            "SET solution = ?, moves = ?, pushes = ? "
+            "WHERE id = ? AND (moves IS NULL OR moves > ? "
+            "	OR (moves = ? AND pushes > ?))"
+        );
+        update_solution.bind(1, data.data(), static_cast<int>(data.size()));
+        update_solution.bind(2, moves);
+        update_solution.bind(3, pushes);
+        update_solution.bind(4, level_id);
+        update_solution.bind(5, moves);
+        update_solution.bind(6, moves);
+        update_solution.bind(7, pushes);
+        update_solution.exec();
+        return true;
+    }
+
+    /**
+	 * @brief 更新压缩的关卡会话移动.
+	 */
+    auto update_session_movement(
+        int level_id,
+        const std::vector<uint8_t>& movement
+    ) -> bool {
+        SQLite::Statement update_movements(
+            database_,
+            "UPDATE tb_session "
+            "SET movement = ? "
+            "WHERE level_id = ?"
+        );
+        update_movements.bind(
+            1,
+            movement.data(),
+            static_cast<int>(movement.size())
+        );
+        update_movements.bind(2, level_id);
+        return update_movements.exec();
+    }
+
+    /**
+	 * @brief 读取移动记录, 旧版本以 LURD 文本存储, 之后以压缩格式存储.
+	 */
+    static auto read_movement(const SQLite::Column& column) -> std::string {
+        if (!column.isBlob())
+            return column.getString();
+        return decode_movement(
+            static_cast<const uint8_t*>(column.getBlob()),
+            static_cast<size_t>(column.getBytes())
+        );
+    }
+
+    /**
+	 * @brief 清除旧版本写入的解缓存.
+	 *
+	 * 旧版本在使用目标房间宏移动时也将解记录为推动次数最少, 这些条目不可信.
+	 */
+    void migrate_solution_cache() {
+        int version = 0;
+        {
+            SQLite::Statement query_version(database_, "PRAGMA user_version");
+            if (query_version.executeStep())
+                version = query_version.getColumn(0).getInt();
+        }
+        if (version >= 1)
+            return;
+        database_.exec("DROP TABLE IF EXISTS tb_solution_cache");
+        database_.exec("PRAGMA user_version = 1");
+    }
+
+    /**
+	 * @brief 为旧版本记录的答案计算移动和推动次数.
+	 */
+    void migrate_solution_metrics() {
+        SQLite::Statement query_solutions(
+            database_,
+            "SELECT id, solution FROM tb_level "
+            "WHERE solution IS NOT NULL AND moves IS NULL"
+        );
+        std::vector<std::pair<int, std::string>> solutions;
+        while (query_solutions.executeStep())
+            solutions.emplace_back(
+                query_solutions.getColumn("id").getInt(),
+                read_movement(query_solutions.getColumn("solution"))
+            );
+        if (solutions.empty())
+            return;
+
+        SQLite::Transaction transaction(database_);
+        for (const auto& [id, solution] : solutions)
+            insert_solution(id, solution);
+        transaction.commit();
+    }
+
+    /**
+	 * @brief 为旧版本创建的表添加缺少的列.
+	 *
+	 * @param table  表名.
+	 * @param column 列名.
+	 * @param type   列类型.
+	 */
+    void add_column_if_missing(
+        const std::string& table,
+        const std::string& column,
+        const std::string& type
+    ) {
+        SQLite::Statement query_columns(
+            database_,
+            "PRAGMA table_info(" + table + ")"
+        );
+        while (query_columns.executeStep())
+            if (query_columns.getColumn("name").getString() == column)
+                return;
+        database_.exec(
+            "ALTER TABLE " + table + " ADD COLUMN " + column + ' ' + type
+        );
+    }
+
     SQLite::Database database_;
+    std::mutex fingerprint_mutex_;
+    std::optional<SQLite::Statement> query_fingerprint_;
 };
@@ -0,0 +1,305 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "tile.hpp"
+
+namespace deadlock {
+
+/**
+ * @brief 死锁模式.
+ *
+ * 每个字符串定义一个模式, 以 '\n' 分隔各行:
+ * - '$': 被检查的箱子.
+ * - '#': 不可移动的图块, 即墙壁或锁死的箱子.
+ * - 'B': 其他箱子.
+ * - 'X': 箱子或不可移动的图块.
+ * - ' ': 任意图块.
+ *
+ * 模式的所有旋转和镜像会在编译期自动生成. 除被检查的箱子外, 模式中的图块必须
+ * 位于其周围 8 格内.
+ */
+inline constexpr std::string_view specs[] = {
+    "#$\n #",
+    "$B\n##",
+    "# \n$B\n #",
+    "$X\nXX",
+};
+
+/**
+ * @brief 死锁模式中图块需要满足的条件.
+ */
+enum class Kind : uint8_t {
+    Unmovable,
+    Crate,
+    Blocked,
+};
+
+/**
+ * @brief 死锁模式中的一个图块, 坐标相对于被检查的箱子.
+ */
+struct Cell {
+    int x;
+    int y;
+    Kind kind;
+
+    constexpr auto operator<=>(const Cell&) const = default;
+};
+
+/**
+ * @brief 死锁模式, 被检查的箱子满足其全部条件时锁死.
+ */
+struct Pattern {
+    std::array<Cell, 8> cells;
+    size_t size;
+
+    constexpr auto operator==(const Pattern&) const -> bool = default;
+};
+
+/**
+ * @brief 获取满足条件的图块.
+ */
+constexpr auto tiles(Kind kind) noexcept -> uint8_t {
+    switch (kind) {
+        case Kind::Unmovable:
+            return Tile::Unmovable;
+
+        case Kind::Crate:
+            return Tile::Crate;
+
+        default:
+            return Tile::Unmovable | Tile::Crate;
+    }
+}
+
+/**
+ * @brief 解析 ASCII 格式的死锁模式.
+ */
+constexpr auto parse(std::string_view spec) -> Pattern {
+    Pattern pattern {};
+    int anchor_x = 0, anchor_y = 0;
+    for (int x = 0, y = 0; const auto c : spec) {
+        if (c == '$') {
+            anchor_x = x;
+            anchor_y = y;
+        }
+        if (c == '\n') {
+            x = 0;
+            y++;
+        } else {
+            x++;
+        }
+    }
+
+    for (int x = 0, y = 0; const auto c : spec) {
+        Kind kind {};
+        switch (c) {
+            case '\n':
+                x = 0;
+                y++;
+                continue;
+
+            case '#':
+                kind = Kind::Unmovable;
+                break;
+
+            case 'B':
+                kind = Kind::Crate;
+                break;
+
+            case 'X':
+                kind = Kind::Blocked;
+                break;
+
+            case '$':
+            case ' ':
+                x++;
+                continue;
+
+            default:
+                throw std::invalid_argument("unknown symbol");
+        }
+        const Cell cell = {x - anchor_x, y - anchor_y, kind};
+        if (cell.x < -1 || cell.x > 1 || cell.y < -1 || cell.y > 1) {
+            throw std::invalid_argument("pattern too large");
+        }
+        pattern.cells[pattern.size++] = cell;
+        x++;
+    }
+    return pattern;
+}
+
+/**
+ * @brief 生成模式的全部 8 种旋转和镜像.
+ */
+constexpr auto symmetries(const Pattern& pattern) -> std::array<Pattern, 8> {
+    std::array<Pattern, 8> result {};
+    for (size_t i = 0; i < 8; i++) {
+        auto& symmetry = result[i];
+        symmetry = pattern;
+        for (size_t j = 0; j < pattern.size; j++) {
+            auto& [x, y, kind] = symmetry.cells[j];
+            if (i >= 4) {
+                x = -x;
+            }
+            for (size_t r = 0; r < i % 4; r++) {
+                x = std::exchange(y, x);
+                x = -x;
+            }
+        }
+        std::sort(
+            symmetry.cells.begin(),
+            symmetry.cells.begin() + symmetry.size
+        );
+    }
+    return result;
+}
+
+/**
+ * @brief 生成全部死锁模式, 并移除重复的模式.
+ */
+constexpr auto generate() {
+    std::array<Pattern, std::size(specs) * 8> result {};
+    size_t count = 0;
+    for (const auto spec : specs) {
+        for (const auto& symmetry : symmetries(parse(spec))) {
+            if (std::find(result.begin(), result.begin() + count, symmetry)
+                == result.begin() + count) {
+                result[count++] = symmetry;
+            }
+        }
+    }
+    return std::pair(result, count);
+}
+
+inline constexpr auto patterns = [] {
+    constexpr auto generated = generate();
+    std::array<Pattern, generated.second> patterns {};
+    std::copy_n(generated.first.begin(), patterns.size(), patterns.begin());
+    return patterns;
+}();
+
+/**
+ * @brief 判断是否匹配第 I 个死锁模式.
+ */
+template<size_t I, class F>
+constexpr auto match_pattern(F& value) {
+    return [&]<size_t... J>(std::index_sequence<J...>) {
+        return (value(std::integral_constant<Cell, patterns[I].cells[J]>())
+                & ...);
+    }(std::make_index_sequence<patterns[I].size>());
+}
+
+/**
+ * @brief 判断是否匹配任意死锁模式, 匹配过程在编译期完全展开.
+ *
+ * @param value 回调函数, 参数为 std::integral_constant 形式的图块,
+ *              返回该图块是否满足条件. 返回整数时可同时匹配多个位置.
+ *
+ * @return 所有模式匹配结果的按位或.
+ */
+template<class F>
+constexpr auto match(F&& value) {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+        return (match_pattern<I>(value) | ...);
+    }(std::make_index_sequence<patterns.size()>());
+}
+
+/**
+ * @brief 将一行位图平移, 使第 x + dx 位对齐到第 x 位.
+ */
+constexpr auto shift(uint64_t row, int dx) noexcept -> uint64_t {
+    return dx >= 0 ? row >> dx : row << -dx;
+}
+
+/**
+ * @brief 匹配一行中的所有死锁模式.
+ *
+ * @param unmovable 指向该行不可移动图块的指针, 需可访问相邻行.
+ * @param crate     指向该行箱子的指针, 需可访问相邻行.
+ *
+ * @return uint64_t 该行中匹配任意死锁模式的箱子.
+ */
+inline auto match_row(const uint64_t* unmovable, const uint64_t* crate) noexcept
+    -> uint64_t {
+    return crate[0] & match([&](auto cell) -> uint64_t {
+               constexpr Cell c = cell;
+               const auto u = shift(unmovable[c.y], c.x);
+               const auto b = shift(crate[c.y], c.x);
+               if constexpr (c.kind == Kind::Unmovable) {
+                   return u;
+               } else if constexpr (c.kind == Kind::Crate) {
+                   return b;
+               } else {
+                   return u | b;
+               }
+           });
+}
+
+/**
+ * @brief 在整个地图上匹配死锁模式, 找出所有锁死的箱子.
+ *
+ * 以每行一个整数的位图表示墙壁, 箱子和锁死箱子, 将相邻行平移对齐后按位运算,
+ * 一次得到一整行中所有匹配死锁模式的箱子. 锁死的箱子会成为新的不可移动图块,
+ * 因此重复匹配直至结果不再变化.
+ *
+ * @param walls  墙壁, 宽度不超过 64 且四周为墙壁.
+ * @param crates 箱子.
+ *
+ * @return Bitboard 锁死的箱子.
+ */
+inline auto find_deadlocked_crates(
+    const Bitboard& walls,
+    const Bitboard& crates
+) -> Bitboard {
+    assert(walls.width() <= 64 && walls.height() == crates.height());
+    const int height = walls.height();
+    const auto& crate = crates.words();
+
+    Bitboard deadlocked(walls.width(), height, Arena::resource());
+    auto& dead = deadlocked.words();
+    std::pmr::vector<uint64_t> unmovable(walls.words(), Arena::resource());
+
+    // 仅需检查包含箱子的行
+    int first = 1, last = height - 2;
+    while (first <= last && crate[first] == 0) {
+        first++;
+    }
+    while (last >= first && crate[last] == 0) {
+        last--;
+    }
+
+    // 新锁死的箱子只会影响相邻的行, 下一轮仅需检查这些行
+    while (first <= last) {
+        int next_first = height, next_last = -1;
+        for (int y = first; y <= last; y++) {
+            const auto matched =
+                match_row(unmovable.data() + y, crate.data() + y);
+            if (matched & ~dead[y]) {
+                dead[y] |= matched;
+                unmovable[y] |= matched;
+                next_first = std::min(next_first, y - 1);
+                next_last = std::max(next_last, y + 1);
+            }
+        }
+        first = std::max(next_first, 1);
+        last = std::min(next_last, height - 2);
+    }
+    return deadlocked;
+}
+
+} // namespace deadlock
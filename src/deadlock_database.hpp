@@ -0,0 +1,383 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+#include "arena.hpp"
+#include "mapped_file.hpp"
+#include "tile.hpp"
+
+/**
+ * @brief 死锁模式数据库.
+ *
+ * 记录已被局部搜索证明无解的 5x5 区域, 区域以中心箱子为中心. 数据库由离线工具
+ * 生成, 以开放寻址哈希表的形式存储在二进制文件中, 运行时通过内存映射只读访问,
+ * 每次查询的时间复杂度为 O(1).
+ */
+class DeadlockDatabase {
+  public:
+    static constexpr int window_size = 5;
+    static constexpr int window_area = window_size * window_size;
+
+    DeadlockDatabase() = default;
+
+    /**
+	 * @brief 加载数据库, 文件不存在时为空数据库.
+	 *
+	 * @param path 数据库文件路径.
+	 */
+    explicit DeadlockDatabase(const std::filesystem::path& path) {
+        if (!std::filesystem::exists(path)) {
+            return;
+        }
+        file_ = MappedFile(path);
+
+        Header header;
+        if (file_.size() < sizeof(header)) {
+            throw std::runtime_error("invalid deadlock database");
+        }
+        std::memcpy(&header, file_.data(), sizeof(header));
+        if (std::memcmp(header.magic, Header().magic, sizeof(header.magic))
+                != 0
+            || header.version != Header().version
+            || !std::has_single_bit(header.capacity)
+            || file_.size()
+                   != sizeof(header) + header.capacity * sizeof(uint64_t)) {
+            throw std::runtime_error("invalid deadlock database");
+        }
+        slots_ =
+            reinterpret_cast<const uint64_t*>(file_.data() + sizeof(header));
+        capacity_ = header.capacity;
+        size_ = header.size;
+    }
+
+    /**
+	 * @brief 判断区域是否已知无解.
+	 *
+	 * @param key 区域的键, 由 encode 生成.
+	 */
+    auto contains(uint64_t key) const noexcept -> bool {
+        if (capacity_ == 0) {
+            return false;
+        }
+        const auto mask = capacity_ - 1;
+        for (auto i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots_[i] == key) {
+                return true;
+            }
+            if (slots_[i] == empty) {
+                return false;
+            }
+        }
+    }
+
+    /**
+	 * @brief 获取全部键.
+	 */
+    auto keys() const -> std::vector<uint64_t> {
+        std::vector<uint64_t> keys;
+        keys.reserve(size_);
+        for (size_t i = 0; i < capacity_; i++) {
+            if (slots_[i] != empty) {
+                keys.push_back(slots_[i]);
+            }
+        }
+        return keys;
+    }
+
+    auto size() const noexcept -> size_t {
+        return size_;
+    }
+
+    /**
+	 * @brief 保存数据库.
+	 *
+	 * @param path 数据库文件路径.
+	 * @param keys 区域的键.
+	 */
+    static void
+    save(const std::filesystem::path& path, const std::vector<uint64_t>& keys) {
+        // 装载因子不超过 0.5
+        const auto capacity =
+            std::bit_ceil(std::max<size_t>(keys.size() * 2, 16));
+        std::vector<uint64_t> slots(capacity, empty);
+        size_t size = 0;
+        for (const auto key : keys) {
+            auto i = hash(key) & (capacity - 1);
+            while (slots[i] != empty && slots[i] != key) {
+                i = (i + 1) & (capacity - 1);
+            }
+            size += slots[i] == empty;
+            slots[i] = key;
+        }
+
+        Header header;
+        header.capacity = capacity;
+        header.size = size;
+
+        // 先写入临时文件再替换, 避免中断时损坏原有数据库
+        auto temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(
+                reinterpret_cast<const char*>(slots.data()),
+                slots.size() * sizeof(uint64_t)
+            );
+            if (!file) {
+                throw std::runtime_error("failed to write deadlock database");
+            }
+        }
+        std::filesystem::rename(temp_path, path);
+    }
+
+    /**
+	 * @brief 生成区域的键.
+	 *
+	 * @param tiles 按行排列的区域图块, 区域外的图块应视为墙壁.
+	 */
+    static auto encode(const std::array<uint8_t, window_area>& tiles) noexcept
+        -> uint64_t {
+        std::array<uint8_t, window_area> cells;
+        std::transform(tiles.begin(), tiles.end(), cells.begin(), state);
+        return pack(cells);
+    }
+
+    /**
+	 * @brief 生成区域在所有旋转和镜像下的键.
+	 *
+	 * @param key 区域的键.
+	 */
+    static auto symmetries(uint64_t key) noexcept
+        -> std::array<uint64_t, 8> {
+        const auto cells = decode(key);
+        std::array<uint64_t, 8> result;
+        for (int i = 0; i < 8; i++) {
+            std::array<uint8_t, window_area> transformed;
+            for (int y = 0; y < window_size; y++) {
+                for (int x = 0; x < window_size; x++) {
+                    int tx = i >= 4 ? window_size - 1 - x : x, ty = y;
+                    for (int r = 0; r < i % 4; r++) {
+                        tx = window_size - 1 - std::exchange(ty, tx);
+                    }
+                    transformed[ty * window_size + tx] =
+                        cells[y * window_size + x];
+                }
+            }
+            result[i] = pack(transformed);
+        }
+        return result;
+    }
+
+    /**
+	 * @brief 通过局部搜索证明区域无解.
+	 *
+	 * 区域外视为可自由通行的地板, 箱子被推出区域后视为已解决, 角色可以位于
+	 * 任意位置. 若在此放宽的条件下仍无法使区域内的箱子全部位于目标上,
+	 * 则该区域在任意关卡中都无解.
+	 *
+	 * @param key        区域的键.
+	 * @param max_states 最大搜索状态数, 超出时视为无法证明.
+	 *
+	 * @return true  区域无解.
+	 * @return false 区域可能有解.
+	 */
+    static auto prove(uint64_t key, size_t max_states = 1 << 16) -> bool {
+        // 在区域四周加上一圈地板, 共 7x7 个格子
+        constexpr int stride = window_size + 2;
+        constexpr uint64_t all = (uint64_t(1) << (stride * stride)) - 1;
+        constexpr auto column = [](int x) {
+            uint64_t mask = 0;
+            for (int y = 0; y < stride; y++) {
+                mask |= uint64_t(1) << (y * stride + x);
+            }
+            return mask;
+        };
+        constexpr auto first_column = column(0);
+        constexpr auto last_column = column(stride - 1);
+        constexpr auto ring = [&] {
+            uint64_t mask = 0;
+            for (int i = 0; i < stride * stride; i++) {
+                const int x = i % stride, y = i / stride;
+                if (x == 0 || y == 0 || x == stride - 1 || y == stride - 1) {
+                    mask |= uint64_t(1) << i;
+                }
+            }
+            return mask;
+        }();
+
+        uint64_t walls = 0, crates = 0, targets = 0;
+        const auto cells = decode(key);
+        for (int i = 0; i < window_area; i++) {
+            const int x = i % window_size + 1, y = i / window_size + 1;
+            const auto bit = uint64_t(1) << (y * stride + x);
+            switch (cells[i]) {
+                case wall:
+                    walls |= bit;
+                    break;
+
+                case crate:
+                    crates |= bit;
+                    break;
+
+                case target:
+                    targets |= bit;
+                    break;
+
+                case crate_on_target:
+                    crates |= bit;
+                    targets |= bit;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        const auto reachable = [&](uint64_t seed, uint64_t free) {
+            for (uint64_t prev = 0; prev != seed;) {
+                prev = seed;
+                seed |= ((seed << 1) & ~first_column)
+                      | ((seed >> 1) & ~last_column) | (seed << stride)
+                      | (seed >> stride);
+                seed &= free & all;
+            }
+            return seed;
+        };
+
+        struct Node {
+            uint64_t crates;
+            int player;
+        };
+        // 容器从 Arena 中分配, 哈希集合的节点来自节点池, 返回时一次性释放
+        Arena::Scope scope;
+        NodePool<32> pool;
+        std::pmr::deque<Node> queue(Arena::resource());
+        std::pmr::unordered_set<uint64_t> visited(&pool);
+        const auto enqueue = [&](uint64_t crates, uint64_t area) {
+            const auto player = std::countr_zero(area);
+            if (visited.insert(crates | uint64_t(player) << 56).second) {
+                queue.push_back({crates, player});
+            }
+        };
+
+        // 角色可能位于任意区域
+        {
+            const auto free = all & ~walls & ~crates;
+            for (auto remaining = free; remaining != 0;) {
+                const auto area = reachable(remaining & -remaining, free);
+                enqueue(crates, area);
+                remaining &= ~area;
+            }
+        }
+
+        while (!queue.empty()) {
+            const auto [crates, player] = queue.front();
+            queue.pop_front();
+            if ((crates & ~targets) == 0) {
+                return false;
+            }
+            if (visited.size() > max_states) {
+                return false;
+            }
+
+            const auto area =
+                reachable(uint64_t(1) << player, all & ~walls & ~crates);
+            for (auto remaining = crates; remaining != 0;
+                 remaining &= remaining - 1) {
+                const auto crate = std::countr_zero(remaining);
+                for (const auto offset : {-stride, stride, -1, 1}) {
+                    const auto from = crate - offset, to = crate + offset;
+                    if (!(area >> from & 1) || ((walls | crates) >> to & 1)) {
+                        continue;
+                    }
+                    auto next = crates & ~(uint64_t(1) << crate);
+                    if (!(ring >> to & 1)) {
+                        next |= uint64_t(1) << to;
+                    }
+                    enqueue(
+                        next,
+                        reachable(uint64_t(1) << crate, all & ~walls & ~next)
+                    );
+                }
+            }
+        }
+        return true;
+    }
+
+  private:
+    struct Header {
+        char magic[4] = {'S', 'K', 'D', 'B'};
+        uint32_t version = 1;
+        uint64_t capacity = 0;
+        uint64_t size = 0;
+    };
+
+    enum CellState : uint8_t {
+        floor,
+        wall,
+        crate,
+        target,
+        crate_on_target,
+        states
+    };
+
+    static constexpr uint64_t empty = 0; // 中心必须为箱子, 因此键不会为 0
+
+    static auto state(uint8_t tile) noexcept -> uint8_t {
+        if (tile & Tile::Wall) {
+            return wall;
+        }
+        if (tile & Tile::Crate) {
+            return tile & Tile::Target ? crate_on_target : crate;
+        }
+        return tile & Tile::Target ? target : floor;
+    }
+
+    static auto pack(const std::array<uint8_t, window_area>& cells) noexcept
+        -> uint64_t {
+        uint64_t key = 0;
+        for (auto it = cells.rbegin(); it != cells.rend(); ++it) {
+            key = key * states + *it;
+        }
+        return key;
+    }
+
+    static auto decode(uint64_t key) noexcept
+        -> std::array<uint8_t, window_area> {
+        std::array<uint8_t, window_area> cells;
+        for (auto& cell : cells) {
+            cell = static_cast<uint8_t>(key % states);
+            key /= states;
+        }
+        return cells;
+    }
+
+    static auto hash(uint64_t key) noexcept -> uint64_t {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccd;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53;
+        key ^= key >> 33;
+        return key;
+    }
+
+    MappedFile file_;
+    const uint64_t* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
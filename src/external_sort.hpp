@@ -0,0 +1,523 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 临时目录, 析构时删除目录及其中的所有文件.
+ */
+class TemporaryDirectory {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param parent 在该目录下创建名称随机的临时目录.
+	 */
+    explicit TemporaryDirectory(
+        const std::filesystem::path& parent =
+            std::filesystem::temp_directory_path()
+    ) {
+        std::random_device device;
+        do {
+            path_ = parent / ("sokoban-" + std::to_string(device()));
+        } while (!std::filesystem::create_directories(path_));
+    }
+
+    ~TemporaryDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(path_, error);
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    auto path() const noexcept -> const std::filesystem::path& {
+        return path_;
+    }
+
+  private:
+    std::filesystem::path path_;
+};
+
+/**
+ * @brief 定长记录文件的顺序读取器.
+ *
+ * 记录由固定数量的 uint16_t 组成. 文件按块读取, 处理当前块时由后台线程预读
+ * 下一块, 使读取与计算重叠.
+ */
+class RecordReader {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param path   文件路径.
+	 * @param width  每条记录包含的 uint16_t 数量.
+	 * @param memory 缓冲区占用的内存上限, 每块最多 4 MiB.
+	 */
+    RecordReader(
+        const std::filesystem::path& path, size_t width, size_t memory
+    ) :
+        file_(path, std::ios::binary), width_(width),
+        capacity_(
+            std::clamp<size_t>(
+                memory / 2 / (width * sizeof(uint16_t)),
+                1,
+                max_chunk / (width * sizeof(uint16_t))
+            )
+            * width
+        ),
+        buffer_(std::make_unique_for_overwrite<uint16_t[]>(capacity_)),
+        next_(std::make_unique_for_overwrite<uint16_t[]>(capacity_)) {
+        if (!file_) {
+            throw std::runtime_error("failed to open file");
+        }
+        prefetch();
+        load();
+    }
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    /**
+	 * @brief 是否已读完所有记录.
+	 */
+    auto empty() const noexcept -> bool {
+        return position_ >= size_;
+    }
+
+    /**
+	 * @brief 获取当前记录, 在调用 next() 前有效.
+	 */
+    auto current() const noexcept -> std::span<const uint16_t> {
+        return {buffer_.get() + position_, width_};
+    }
+
+    /**
+	 * @brief 移动至下一条记录.
+	 */
+    void next() {
+        position_ += width_;
+        if (position_ >= size_) {
+            load();
+        }
+    }
+
+  private:
+    /**
+	 * @brief 等待预读完成并切换至预读的块.
+	 */
+    void load() {
+        position_ = 0;
+        if (!reader_.joinable()) {
+            size_ = 0; // 已读至文件末尾
+            return;
+        }
+        reader_.join();
+        if (failed_) {
+            throw std::runtime_error("failed to read file");
+        }
+        std::swap(buffer_, next_);
+        size_ = next_size_;
+        if (size_ != 0) {
+            prefetch();
+        }
+    }
+
+    /**
+	 * @brief 在后台读取下一块.
+	 */
+    void prefetch() {
+        reader_ = std::jthread([this] {
+            file_.read(
+                reinterpret_cast<char*>(next_.get()),
+                static_cast<std::streamsize>(capacity_ * sizeof(uint16_t))
+            );
+            failed_ = file_.bad();
+            const auto count =
+                static_cast<size_t>(file_.gcount()) / sizeof(uint16_t);
+            next_size_ = count - count % width_;
+        });
+    }
+
+    static constexpr size_t max_chunk = 4 << 20;
+
+    std::ifstream file_;
+    size_t width_;
+    size_t capacity_; // 每块容纳的 uint16_t 数量
+    std::unique_ptr<uint16_t[]> buffer_; // 当前块
+    std::unique_ptr<uint16_t[]> next_;   // 预读的块
+    size_t size_ = 0;
+    size_t next_size_ = 0;
+    size_t position_ = 0;
+    bool failed_ = false;
+    std::jthread reader_;
+};
+
+/**
+ * @brief 定长记录文件的顺序写入器.
+ *
+ * 记录先写入缓冲区, 缓冲区满时由后台线程写入文件, 同时继续接收记录.
+ */
+class RecordWriter {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param path   文件路径, 已存在时会被覆盖.
+	 * @param memory 缓冲区占用的内存上限.
+	 */
+    RecordWriter(const std::filesystem::path& path, size_t memory) :
+        file_(path, std::ios::binary | std::ios::trunc),
+        capacity_(std::max<size_t>(memory / 2 / sizeof(uint16_t), 1)) {
+        if (!file_) {
+            throw std::runtime_error("failed to open file");
+        }
+        buffer_.reserve(capacity_);
+    }
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    void write(std::span<const uint16_t> record) {
+        buffer_.insert(buffer_.end(), record.begin(), record.end());
+        if (buffer_.size() >= capacity_) {
+            flush();
+        }
+    }
+
+    /**
+	 * @brief 写入剩余的记录并关闭文件.
+	 */
+    void close() {
+        flush();
+        wait();
+        file_.close();
+        if (!file_) {
+            throw std::runtime_error("failed to write file");
+        }
+    }
+
+  private:
+    /**
+	 * @brief 在后台写入缓冲区中的记录.
+	 */
+    void flush() {
+        wait();
+        std::swap(buffer_, pending_);
+        buffer_.clear();
+        buffer_.reserve(capacity_);
+        writer_ = std::jthread([this] {
+            file_.write(
+                reinterpret_cast<const char*>(pending_.data()),
+                static_cast<std::streamsize>(
+                    pending_.size() * sizeof(uint16_t)
+                )
+            );
+            failed_ = !file_;
+        });
+    }
+
+    void wait() {
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+        if (failed_) {
+            throw std::runtime_error("failed to write file");
+        }
+    }
+
+    std::ofstream file_;
+    size_t capacity_;
+    std::vector<uint16_t> buffer_;  // 正在接收记录的缓冲区
+    std::vector<uint16_t> pending_; // 正在写入文件的缓冲区
+    bool failed_ = false;
+    std::jthread writer_;
+};
+
+/**
+ * @brief 定长记录的外部排序与去重.
+ *
+ * 记录先存入内存缓冲区, 缓冲区满时由后台线程排序, 去重并写入临时文件, 同时
+ * 继续接收记录. 所有记录接收完毕后, 归并各临时文件并排除已访问的记录.
+ * 内存占用不超过构造时指定的上限.
+ */
+class ExternalSorter {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param directory 存放临时文件的目录.
+	 * @param width     每条记录包含的 uint16_t 数量.
+	 * @param memory    内存上限.
+	 */
+    ExternalSorter(
+        std::filesystem::path directory, size_t width, size_t memory
+    ) :
+        directory_(std::move(directory)), width_(width), memory_(memory),
+        io_memory_(std::min<size_t>(memory / 8, 1 << 20)),
+        capacity_(
+            std::max<size_t>(
+                (memory - io_memory_ * 2) / 2
+                    / (width * sizeof(uint16_t) + sizeof(uint32_t)),
+                1
+            )
+            * width
+        ) {}
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    ~ExternalSorter() {
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        for (const auto& run : runs_) {
+            std::error_code error;
+            std::filesystem::remove(run, error);
+        }
+    }
+
+    void push(std::span<const uint16_t> record) {
+        if (buffer_.empty()) {
+            buffer_.reserve(capacity_);
+        }
+        buffer_.insert(buffer_.end(), record.begin(), record.end());
+        if (buffer_.size() >= capacity_) {
+            spill();
+        }
+    }
+
+    /**
+	 * @brief 归并所有记录, 输出不在已访问记录中的新记录.
+	 *
+	 * @param visited 已排序去重的已访问记录文件, 不存在时视为空.
+	 * @param output  新记录的输出文件.
+	 * @param merged  已访问记录与新记录的并集的输出文件.
+	 *
+	 * @return 新记录的数量.
+	 */
+    auto merge(
+        const std::filesystem::path& visited,
+        const std::filesystem::path& output,
+        const std::filesystem::path& merged
+    ) -> size_t {
+        if (!buffer_.empty()) {
+            spill();
+        }
+        wait();
+        buffer_ = {};
+        sorting_ = {};
+
+        RecordWriter output_writer(output, io_memory_);
+        RecordWriter merged_writer(merged, io_memory_);
+        const auto excluded = std::filesystem::exists(visited)
+                                ? std::optional(visited)
+                                : std::nullopt;
+        const auto count = merge_files(
+            runs_,
+            excluded,
+            output_writer,
+            &merged_writer,
+            memory_ - io_memory_ * 2
+        );
+        output_writer.close();
+        merged_writer.close();
+        return count;
+    }
+
+    /**
+	 * @brief 比较两条记录, 按字典序排列.
+	 */
+    static auto less(
+        std::span<const uint16_t> a, std::span<const uint16_t> b
+    ) noexcept -> bool {
+        return std::ranges::lexicographical_compare(a, b);
+    }
+
+  private:
+    static constexpr size_t max_runs = 64; // 一次归并的最大文件数
+
+    /**
+	 * @brief 在后台排序缓冲区中的记录并写入新的临时文件.
+	 */
+    void spill() {
+        wait();
+        if (runs_.size() >= max_runs) {
+            compact();
+        }
+        std::swap(buffer_, sorting_);
+        buffer_.clear();
+
+        runs_.push_back(
+            directory_ / ("run-" + std::to_string(next_run_++))
+        );
+        worker_ = std::jthread([this, path = runs_.back()] {
+            try {
+                write_run(path);
+            } catch (...) {
+                error_ = std::current_exception();
+            }
+        });
+    }
+
+    void wait() {
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+    void write_run(const std::filesystem::path& path) {
+        const auto record = [&](uint32_t i) {
+            return std::span<const uint16_t>(sorting_).subspan(
+                i * width_, width_
+            );
+        };
+        std::vector<uint32_t> order(sorting_.size() / width_);
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::sort(order, [&](uint32_t a, uint32_t b) {
+            return less(record(a), record(b));
+        });
+
+        RecordWriter writer(path, io_memory_);
+        std::span<const uint16_t> previous;
+        for (const auto i : order) {
+            if (previous.empty() || !std::ranges::equal(record(i), previous)) {
+                previous = record(i);
+                writer.write(previous);
+            }
+        }
+        writer.close();
+    }
+
+    /**
+	 * @brief 将所有临时文件归并为一个, 避免同时打开过多文件.
+	 */
+    void compact() {
+        sorting_ = {};
+        const auto path = directory_ / ("run-" + std::to_string(next_run_++));
+        RecordWriter writer(path, io_memory_);
+        merge_files(runs_, std::nullopt, writer, nullptr, memory_ / 2);
+        writer.close();
+        for (const auto& run : runs_) {
+            std::filesystem::remove(run);
+        }
+        runs_ = {path};
+    }
+
+    /**
+	 * @brief 多路归并已排序去重的记录文件.
+	 *
+	 * @param inputs   输入文件.
+	 * @param excluded 需要排除的记录所在的文件.
+	 * @param output   不在 excluded 中的记录的输出.
+	 * @param merged   所有记录的输出, 包括 excluded 中的记录.
+	 * @param memory   读取缓冲区的内存上限.
+	 *
+	 * @return 写入 output 的记录数量.
+	 */
+    auto merge_files(
+        const std::vector<std::filesystem::path>& inputs,
+        const std::optional<std::filesystem::path>& excluded,
+        RecordWriter& output,
+        RecordWriter* merged,
+        size_t memory
+    ) const -> size_t {
+        const auto reader_memory = memory / (inputs.size() + 1);
+        std::vector<std::unique_ptr<RecordReader>> readers;
+        for (const auto& input : inputs) {
+            readers.push_back(
+                std::make_unique<RecordReader>(input, width_, reader_memory)
+            );
+        }
+        std::unique_ptr<RecordReader> visited;
+        if (excluded.has_value()) {
+            visited = std::make_unique<RecordReader>(
+                *excluded, width_, reader_memory
+            );
+        }
+
+        const auto greater = [&](size_t a, size_t b) {
+            return less(readers[b]->current(), readers[a]->current());
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(greater)>
+            queue(greater);
+        for (size_t i = 0; i < readers.size(); i++) {
+            if (!readers[i]->empty()) {
+                queue.push(i);
+            }
+        }
+
+        size_t count = 0;
+        std::vector<uint16_t> previous;
+        while (!queue.empty()) {
+            const auto i = queue.top();
+            queue.pop();
+            const auto record = readers[i]->current();
+            if (previous.empty() || !std::ranges::equal(record, previous)) {
+                previous.assign(record.begin(), record.end());
+
+                // 已访问的记录按序写入并集, 直至不小于当前记录
+                bool duplicate = false;
+                while (visited != nullptr && !visited->empty()
+                       && less(visited->current(), record)) {
+                    merged->write(visited->current());
+                    visited->next();
+                }
+                if (visited != nullptr && !visited->empty()) {
+                    duplicate = std::ranges::equal(visited->current(), record);
+                }
+                if (!duplicate) {
+                    output.write(record);
+                    if (merged != nullptr) {
+                        merged->write(record);
+                    }
+                    count++;
+                }
+            }
+            readers[i]->next();
+            if (!readers[i]->empty()) {
+                queue.push(i);
+            }
+        }
+        while (visited != nullptr && !visited->empty()) {
+            merged->write(visited->current());
+            visited->next();
+        }
+        return count;
+    }
+
+    std::filesystem::path directory_;
+    size_t width_;
+    size_t memory_;
+    size_t io_memory_; // 每个写入器的缓冲区大小
+    size_t capacity_;                // 缓冲区容纳的 uint16_t 数量
+    std::vector<uint16_t> buffer_;   // 正在接收记录的缓冲区
+    std::vector<uint16_t> sorting_;  // 正在后台排序的缓冲区
+    std::vector<std::filesystem::path> runs_;
+    size_t next_run_ = 0;
+    std::exception_ptr error_;
+    std::jthread worker_;
+};
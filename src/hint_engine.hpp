@@ -0,0 +1,217 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <cctype>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SFML/System/Vector2.hpp"
+#include "database.hpp"
+#include "level.hpp"
+#include "pattern_database.hpp"
+#include "solver.hpp"
+#include "tile.hpp"
+
+/**
+ * @brief 提示引擎, 在后台线程中求解关卡的当前状态并给出下一次推动.
+ *
+ * 关卡状态改变后取消正在进行的求解, 并将求解器的起点移至新状态. 同一地图的
+ * 求解器被复用, 其置换表记录了已求得的解经过的状态, 因此沿提示推动, 撤回或
+ * 在可到达区域内走动后, 提示可以在下一帧给出而无需重新搜索. 指定数据库时,
+ * 解还会被写入解缓存, 之后再次遇到这些局面时只需查询.
+ */
+class HintEngine {
+  public:
+    /**
+	 * @brief 提示, 将位于 crate 的箱子推至 target.
+	 */
+    struct Hint {
+        sf::Vector2i crate;
+        sf::Vector2i target;
+
+        auto operator==(const Hint&) const -> bool = default;
+    };
+
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param database_path 存放解缓存的数据库路径, 为空时不使用解缓存.
+	 */
+    explicit HintEngine(std::filesystem::path database_path = {}) :
+        database_path_(std::move(database_path)),
+        thread_([this](const std::stop_token& token) { run(token); }) {}
+
+    ~HintEngine() {
+        stop();
+    }
+
+    HintEngine(const HintEngine&) = delete;
+    HintEngine& operator=(const HintEngine&) = delete;
+
+    /**
+	 * @brief 提交关卡的当前状态, 状态未改变时忽略.
+	 */
+    void update(const Level& level) {
+        auto tiles = signature(level);
+        std::lock_guard lock(mutex_);
+        if (tiles == tiles_) {
+            return;
+        }
+        tiles_ = std::move(tiles);
+        pending_.emplace(level);
+        version_++;
+        hint_.reset();
+        cancel_.request_stop();
+        condition_.notify_one();
+    }
+
+    /**
+	 * @brief 获取最近一次提交的状态的提示.
+	 *
+	 * @return 尚未求出, 无解或关卡已完成时返回 std::nullopt.
+	 */
+    auto hint() const -> std::optional<Hint> {
+        std::lock_guard lock(mutex_);
+        return hint_;
+    }
+
+    /**
+	 * @brief 停止后台线程, 正在进行的求解会被取消.
+	 */
+    void stop() {
+        if (thread_.joinable()) {
+            thread_.request_stop();
+            thread_.join();
+        }
+    }
+
+  private:
+    static constexpr size_t memory_budget = size_t(256) << 20;
+
+    void run(const std::stop_token& token) {
+        // 后台线程使用独立的数据库连接
+        std::optional<Database> database;
+        if (!database_path_.empty()) {
+            try {
+                database.emplace(database_path_);
+            } catch (const SQLite::Exception&) {
+            }
+        }
+        std::optional<Solver> solver;
+        while (true) {
+            std::optional<Level> level;
+            size_t version;
+            std::stop_source cancel;
+            {
+                std::unique_lock lock(mutex_);
+                if (!condition_.wait(lock, token, [this] {
+                        return pending_.has_value();
+                    })) {
+                    return;
+                }
+                level = std::exchange(pending_, std::nullopt);
+                version = version_;
+                cancel_ = cancel;
+            }
+            const std::stop_callback forward(token, [&cancel] {
+                cancel.request_stop();
+            });
+
+            // 地图相同时复用求解器, 保留置换表中已知的解
+            if (!solver.has_value() || !solver->reroot(*level)) {
+                solver.emplace(*level);
+                solver->set_pattern_database(
+                    PatternDatabase(solver->board(), 1)
+                );
+                solver->set_memory_budget(memory_budget);
+                if (database.has_value()) {
+                    set_solution_cache(*solver, *database);
+                }
+            }
+            const auto solution =
+                solver->solve(Solver::Mode::Forward, cancel.get_token());
+            if (!solution.has_value()) {
+                continue;
+            }
+
+            std::lock_guard lock(mutex_);
+            if (version == version_) {
+                hint_ = first_push(*level, *solution);
+            }
+        }
+    }
+
+    /**
+	 * @brief 使求解器使用数据库中的解缓存, 缓存只用于加速, 读写失败时忽略.
+	 */
+    static void set_solution_cache(Solver& solver, Database& database) {
+        solver.set_solution_cache(
+            [&database](uint64_t hash) -> std::optional<CachedSolution> {
+                try {
+                    return database.get_cached_solution(hash);
+                } catch (const SQLite::Exception&) {
+                    return std::nullopt;
+                }
+            },
+            [&database](const std::vector<CachedSolution>& entries) {
+                try {
+                    database.update_solution_cache(entries);
+                } catch (const SQLite::Exception&) {
+                }
+            }
+        );
+    }
+
+    /**
+	 * @brief 获取解中的第一次推动.
+	 */
+    static auto first_push(const Level& level, const std::string& solution)
+        -> std::optional<Hint> {
+        auto player = level.player_position();
+        for (const auto move : solution) {
+            const auto direction = movement_to_direction(move);
+            player += direction;
+            if (std::isupper(move)) {
+                return Hint {player, player + direction};
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+	 * @brief 获取关卡状态的签名, 忽略死锁和可移动区域等标记.
+	 */
+    static auto signature(const Level& level) -> std::vector<uint8_t> {
+        constexpr uint8_t mask = Tile::Floor | Tile::Wall | Tile::Crate
+                               | Tile::Target | Tile::Player;
+        std::vector<uint8_t> tiles(level.map());
+        for (auto& tile : tiles) {
+            tile &= mask;
+        }
+        tiles.push_back(static_cast<uint8_t>(level.size().x));
+        return tiles;
+    }
+
+    std::filesystem::path database_path_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any condition_;
+    std::vector<uint8_t> tiles_;
+    std::optional<Level> pending_;
+    size_t version_ = 0;
+    std::stop_source cancel_;
+    std::optional<Hint> hint_;
+
+    std::jthread thread_;
+};
@@ -0,0 +1,208 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 紧凑的移动记录.
+ *
+ * 每步移动占用 4 位: 2 位方向, 1 位是否推动箱子, 1 位是否为一组移动的开始.
+ * 移动步数和推动次数随记录增减实时维护, 仅在导出时生成 LURD 字符串.
+ */
+class History {
+  public:
+    /**
+	 * @brief 添加一步移动.
+	 *
+	 * @param move      LURD 格式移动, 大写表示推动箱子.
+	 * @param new_group 是否开始新的一组移动.
+	 */
+    void push_back(char move, bool new_group = false) {
+        if (size_ % moves_per_word == 0) {
+            data_.push_back(0);
+        }
+        uint64_t bits = encode(move);
+        if (std::isupper(move)) {
+            bits |= push_bit;
+            push_count_++;
+        }
+        if (new_group || size_ == 0) {
+            bits |= group_bit;
+        }
+        data_.back() |= bits << shift(size_);
+        size_++;
+    }
+
+    /**
+	 * @brief 截断移动记录, 仅保留前 size 步移动.
+	 *
+	 * @param size 保留的移动步数.
+	 */
+    void truncate(size_t size) {
+        if (size >= size_) {
+            return;
+        }
+        for (auto i = size; i < size_; i++) {
+            if (pushed(i)) {
+                push_count_--;
+            }
+        }
+        size_ = size;
+        data_.resize((size + moves_per_word - 1) / moves_per_word);
+        if (size % moves_per_word != 0) {
+            data_.back() &= (uint64_t(1) << shift(size)) - 1;
+        }
+    }
+
+    /**
+	 * @brief 移除最后一组移动.
+	 *
+	 * @return std::string 被移除的 LURD 格式移动记录.
+	 */
+    auto pop_group() -> std::string {
+        if (empty()) {
+            return "";
+        }
+        auto begin = size_ - 1;
+        while (!(bits(begin) & group_bit)) {
+            begin--;
+        }
+        auto movement = str(begin, size_);
+        truncate(begin);
+        return movement;
+    }
+
+    void clear() noexcept {
+        data_.clear();
+        size_ = 0;
+        push_count_ = 0;
+    }
+
+    auto operator[](size_t index) const -> char {
+        assert(index < size_);
+        const auto move = "udlr"[bits(index) & direction_mask];
+        return pushed(index) ? std::toupper(move) : move;
+    }
+
+    auto back() const -> char {
+        return (*this)[size_ - 1];
+    }
+
+    /**
+	 * @brief 是否推动了箱子.
+	 *
+	 * @param index 移动索引.
+	 */
+    auto pushed(size_t index) const -> bool {
+        return bits(index) & push_bit;
+    }
+
+    /**
+	 * @brief 生成 LURD 格式移动记录.
+	 *
+	 * @param begin 起始移动索引.
+	 * @param end   终止移动索引.
+	 */
+    auto str(size_t begin, size_t end) const -> std::string {
+        std::string movement;
+        movement.reserve(end - begin);
+        for (auto i = begin; i < end; i++) {
+            movement.push_back((*this)[i]);
+        }
+        return movement;
+    }
+
+    /**
+	 * @brief 生成完整的 LURD 格式移动记录.
+	 */
+    auto lurd() const -> std::string {
+        return str(0, size_);
+    }
+
+    /**
+	 * @brief 与另一移动记录相同的前缀长度, 忽略分组.
+	 *
+	 * @param other 另一移动记录.
+	 */
+    auto common_prefix(const History& other) const -> size_t {
+        // 每个字的分组位被忽略, 相同的字可以一次比较多步移动
+        constexpr uint64_t mask = 0x7777'7777'7777'7777;
+        const auto size = std::min(size_, other.size_);
+        size_t word = 0;
+        while ((word + 1) * moves_per_word <= size
+               && ((data_[word] ^ other.data_[word]) & mask) == 0) {
+            word++;
+        }
+        auto index = word * moves_per_word;
+        while (index < size
+               && ((bits(index) ^ other.bits(index)) & ~group_bit) == 0) {
+            index++;
+        }
+        return index;
+    }
+
+    auto empty() const noexcept -> bool {
+        return size_ == 0;
+    }
+
+    /**
+	 * @brief 移动步数.
+	 */
+    auto size() const noexcept -> size_t {
+        return size_;
+    }
+
+    /**
+	 * @brief 推动次数.
+	 */
+    auto pushes() const noexcept -> size_t {
+        return push_count_;
+    }
+
+  private:
+    static constexpr size_t bits_per_move = 4;
+    static constexpr size_t moves_per_word = 64 / bits_per_move;
+
+    static constexpr uint64_t direction_mask = 0b0011;
+    static constexpr uint64_t push_bit = 0b0100;
+    static constexpr uint64_t group_bit = 0b1000;
+
+    static auto encode(char move) -> uint64_t {
+        switch (std::tolower(move)) {
+            case 'u':
+                return 0;
+
+            case 'd':
+                return 1;
+
+            case 'l':
+                return 2;
+
+            case 'r':
+                return 3;
+
+            default:
+                throw std::invalid_argument("invalid movement");
+        }
+    }
+
+    static auto shift(size_t index) noexcept -> size_t {
+        return index % moves_per_word * bits_per_move;
+    }
+
+    auto bits(size_t index) const -> uint64_t {
+        return (data_[index / moves_per_word] >> shift(index)) & 0b1111;
+    }
+
+    std::vector<uint64_t> data_;
+    size_t size_ = 0;
+    size_t push_count_ = 0;
+};
@@ -0,0 +1,254 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "crc32.hpp"
+#include "history.hpp"
+#include "movement_codec.hpp"
+
+/**
+ * @brief 会话移动的追加日志.
+ *
+ * 移动记录的变化以记录的形式追加到文件末尾, 而不是在每次移动后重写数据库中
+ * 完整的会话移动. 写入的数据会立即交给操作系统, 程序崩溃时不会丢失; 每累积
+ * sync_moves 步移动或距上次同步超过 sync_interval 时才调用 fsync, 因此系统
+ * 崩溃时最多丢失这段时间内的移动.
+ *
+ * 每条记录由类型, 负载长度, 负载和 CRC32 组成. 重放时遇到不完整或校验失败的
+ * 记录即停止, 因此写入中途崩溃只会丢失最后一条记录.
+ *
+ * 日志不是线程安全的, 开始, 记录和清除须在读写移动记录的同一线程中进行.
+ */
+class Journal {
+  public:
+    /**
+	 * @brief 从日志恢复的会话.
+	 */
+    struct Session {
+        int level_id;
+        std::string movement; // LURD 格式移动记录
+    };
+
+    explicit Journal(std::filesystem::path path) : path_(std::move(path)) {}
+
+    ~Journal() {
+        close();
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+	 * @brief 开始记录关卡的会话, 日志中之前的内容被丢弃.
+	 *
+	 * @param level_id 关卡 ID.
+	 * @param history  关卡当前的移动记录.
+	 */
+    void begin(int level_id, const History& history) {
+        close();
+        file_ = std::fopen(path_.string().c_str(), "wb");
+        if (file_ == nullptr) {
+            throw std::runtime_error("failed to open journal");
+        }
+        write_record(Record::Session, encode_u32(level_id));
+        write_record(Record::Append, encode_movement(history));
+        history_ = history;
+        sync();
+    }
+
+    /**
+	 * @brief 记录移动记录的变化, 并按需同步到磁盘.
+	 *
+	 * 应被频繁调用, 例如每帧一次. 未开始记录时忽略.
+	 *
+	 * @param history 关卡当前的移动记录.
+	 */
+    void record(const History& history) {
+        if (file_ == nullptr) {
+            return;
+        }
+        const auto common = history.common_prefix(history_);
+        if (common < history_.size()) {
+            write_record(
+                Record::Truncate,
+                encode_u32(static_cast<uint32_t>(common))
+            );
+        }
+        if (common < history.size()) {
+            write_record(
+                Record::Append,
+                encode_movement(history.str(common, history.size()))
+            );
+        }
+        const auto changes =
+            history_.size() - common + history.size() - common;
+        if (changes > 0) {
+            history_ = history;
+            std::fflush(file_);
+            unsynced_moves_ += changes;
+        }
+
+        if (unsynced_moves_ >= sync_moves
+            || (unsynced_moves_ > 0
+                && std::chrono::steady_clock::now() - last_sync_
+                       >= sync_interval)) {
+            sync();
+        }
+    }
+
+    /**
+	 * @brief 停止记录并删除日志, 应在会话被写入数据库后调用.
+	 */
+    void clear() {
+        close();
+        std::error_code error;
+        std::filesystem::remove(path_, error);
+    }
+
+    /**
+	 * @brief 重放日志.
+	 *
+	 * @return 日志不存在或不包含会话时返回 std::nullopt.
+	 */
+    auto replay() const -> std::optional<Session> {
+        std::ifstream file(path_, std::ios::binary);
+        if (!file) {
+            return std::nullopt;
+        }
+        const std::vector<uint8_t> data(
+            (std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>()
+        );
+
+        std::optional<Session> session;
+        for (size_t offset = 0; offset + header_size <= data.size();) {
+            const auto size = read_u32(&data[offset + 1]);
+            const auto end = offset + header_size + size;
+            if (end + sizeof(uint32_t) > data.size()
+                || read_u32(&data[end])
+                       != crc32(0, &data[offset], end - offset)) {
+                break;
+            }
+            const auto* payload = &data[offset + header_size];
+            switch (static_cast<Record>(data[offset])) {
+                case Record::Session:
+                    if (size != sizeof(uint32_t)) {
+                        return session;
+                    }
+                    session = Session {static_cast<int>(read_u32(payload)), {}};
+                    break;
+
+                case Record::Truncate:
+                    if (!session.has_value() || size != sizeof(uint32_t)) {
+                        return session;
+                    }
+                    if (read_u32(payload) < session->movement.size()) {
+                        session->movement.resize(read_u32(payload));
+                    }
+                    break;
+
+                case Record::Append:
+                    if (!session.has_value()) {
+                        return session;
+                    }
+                    session->movement += decode_movement(payload, size);
+                    break;
+
+                default:
+                    return session;
+            }
+            offset = end + sizeof(uint32_t);
+        }
+        return session;
+    }
+
+  private:
+    enum class Record : uint8_t {
+        Session = 'S',  // 开始会话, 负载为关卡 ID
+        Truncate = 'T', // 截断移动记录, 负载为保留的移动步数
+        Append = 'A',   // 追加移动, 负载为压缩的移动记录
+    };
+
+    static constexpr size_t header_size = 1 + sizeof(uint32_t);
+    static constexpr size_t sync_moves = 64;
+    static constexpr auto sync_interval = std::chrono::seconds(1);
+
+    void write_record(Record type, const std::vector<uint8_t>& payload) {
+        std::vector<uint8_t> record {static_cast<uint8_t>(type)};
+        const auto size = encode_u32(static_cast<uint32_t>(payload.size()));
+        record.insert(record.end(), size.begin(), size.end());
+        record.insert(record.end(), payload.begin(), payload.end());
+        const auto crc = encode_u32(crc32(0, record.data(), record.size()));
+        record.insert(record.end(), crc.begin(), crc.end());
+        if (std::fwrite(record.data(), 1, record.size(), file_)
+            != record.size()) {
+            throw std::runtime_error("failed to write journal");
+        }
+    }
+
+    /**
+	 * @brief 将已写入的数据同步到磁盘.
+	 */
+    void sync() {
+        std::fflush(file_);
+#ifdef _WIN32
+        _commit(_fileno(file_));
+#else
+        fsync(fileno(file_));
+#endif
+        unsynced_moves_ = 0;
+        last_sync_ = std::chrono::steady_clock::now();
+    }
+
+    void close() {
+        if (file_ == nullptr) {
+            return;
+        }
+        sync();
+        std::fclose(file_);
+        file_ = nullptr;
+        history_.clear();
+    }
+
+    static auto encode_u32(uint32_t value) -> std::vector<uint8_t> {
+        return {
+            static_cast<uint8_t>(value),
+            static_cast<uint8_t>(value >> 8),
+            static_cast<uint8_t>(value >> 16),
+            static_cast<uint8_t>(value >> 24)
+        };
+    }
+
+    static auto read_u32(const uint8_t* data) -> uint32_t {
+        return data[0] | data[1] << 8 | data[2] << 16
+             | static_cast<uint32_t>(data[3]) << 24;
+    }
+
+    std::filesystem::path path_;
+
+    std::FILE* file_ = nullptr;
+    History history_; // 已写入日志的移动记录
+    size_t unsynced_moves_ = 0;
+    std::chrono::steady_clock::time_point last_sync_;
+};
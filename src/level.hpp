@@ -5,21 +5,29 @@
 
 #include <SFML/Graphics.hpp>
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
 #include <cmath>
 #include <filesystem>
 #include <fstream>
-#include <numeric>
+#include <limits>
+#include <memory>
+#include <memory_resource>
 #include <queue>
 #include <stdexcept>
 #include <string>
-#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "animation.hpp"
+#include "arena.hpp"
+#include "bitboard.hpp"
 #include "crc32.hpp"
+#include "deadlock.hpp"
+#include "deadlock_database.hpp"
+#include "history.hpp"
 #include "material.hpp"
 #include "tile.hpp"
 
@@ -161,62 +169,39 @@ class Level {
 	 * @brief 移动角色.
 	 *
 	 * @param movement LURD 格式移动记录.
-	 * @param interval 移动间隔.
+	 * @param merge    是否合并到上一条移动记录.
 	 */
-    void play(
-        std::string movement,
-        std::chrono::milliseconds interval = std::chrono::milliseconds(0)
-    ) {
-        if (movement.empty()) {
-            return;
-        }
-        for (auto& move : movement) {
-            const auto direction = movement_to_direction(move);
-            const auto player_next_pos = player_position_ + direction;
-            player_direction_ = direction;
-            if (at(player_next_pos) & Tile::Wall) {
+    void play(const std::string& movement, bool merge = false) {
+        bool append = merge && !history_.empty();
+        for (const auto move : movement) {
+            // 仅记录实际发生的移动, 撞墙的移动无需撤回
+            const auto record = step(move);
+            if (record == '\0') {
                 continue;
             }
-            if (at(player_next_pos) & Tile::Crate) {
-                const auto crate_next_pos = player_next_pos + direction;
-                if (at(crate_next_pos) & (Tile::Wall | Tile::Crate)) {
-                    continue;
-                }
-
-                at(player_next_pos) &= ~Tile::Crate;
-                at(crate_next_pos) |= Tile::Crate;
-                crate_positions_.erase(player_next_pos);
-                crate_positions_.insert(crate_next_pos);
-                check_deadlock(crate_next_pos);
+            history_.push_back(record, !append);
+            append = true;
 
-                at(player_position_) &= ~Tile::Player;
-                at(player_next_pos) |= Tile::Player;
-                player_position_ = player_next_pos;
-
-                move = rotate_movement(std::toupper(move), -rotation_);
-            } else {
-                at(player_position_) &= ~Tile::Player;
-                at(player_next_pos) |= Tile::Player;
-                player_position_ = player_next_pos;
-
-                move = rotate_movement(std::tolower(move), -rotation_);
+            if (history_.size() % checkpoint_interval == 0) {
+                save_checkpoint();
             }
-            std::this_thread::sleep_for(interval);
         }
-        movements_.emplace_back(movement);
     }
 
     /**
 	 * @brief 撤回上一步操作.
 	 */
     void undo() {
-        if (movements_.empty()) {
+        if (history_.empty()) {
             return;
         }
 
-        auto movement = movements_.back();
-        movements_.pop_back();
+        auto movement = history_.pop_group();
+        while (checkpoints_.back().moves > history_.size()) {
+            checkpoints_.pop_back();
+        }
 
+        bool pulled = false;
         std::reverse(movement.begin(), movement.end());
         for (const auto move : movement) {
             const auto last_direction =
@@ -225,33 +210,57 @@ class Level {
             if (std::isupper(move)) {
                 // 拉箱子
                 const auto crate_pos = player_position_ + last_direction;
-                at(crate_pos) &= ~Tile::Crate;
-                at(player_position_) |= Tile::Crate;
+                auto& crate_last = cell(player_position_);
+                crates_on_target_ -= (cell(crate_pos) & Tile::Target) != 0;
+                crates_on_target_ += (crate_last & Tile::Target) != 0;
+                cell(crate_pos) &= ~Tile::Crate;
+                crate_last |= Tile::Crate;
                 crate_positions_.erase(crate_pos);
                 crate_positions_.insert(player_position_);
-                refresh_deadlocks();
+                pulled = true;
             }
             const auto player_last_pos = player_position_ - last_direction;
-            at(player_position_) &= ~Tile::Player;
-            at(player_last_pos) |= Tile::Player;
+            cell(player_position_) &= ~Tile::Player;
+            cell(player_last_pos) |= Tile::Player;
             player_position_ = player_last_pos;
         }
+        if (pulled) {
+            refresh_deadlocks();
+        }
     }
 
     /**
 	 * @brief 还原至最初状态.
 	 */
     void reset() {
-        clear(Tile::Deadlocked | Tile::PlayerMovable | Tile::CrateMovable);
-        while (!movements_.empty()) {
-            undo();
-        }
+        clear(Tile::PlayerMovable | Tile::CrateMovable);
+        checkpoints_.resize(1);
+        restore(checkpoints_.front());
+        history_.clear();
         while (rotation_) {
             rotate();
         }
         player_direction_ = {0, 1};
     }
 
+    /**
+	 * @brief 跳转至第 n 步移动后的状态, 并丢弃其后的移动记录.
+	 *
+	 * 从不晚于目标的最近检查点恢复, 再重新执行剩余的移动,
+	 * 因此耗时与检查点间隔成正比, 而与移动记录总长度无关.
+	 *
+	 * @param n 移动步数, 超出当前移动步数时视为当前移动步数.
+	 */
+    void seek(size_t n) {
+        n = std::min(n, history_.size());
+        checkpoints_.resize(n / checkpoint_interval + 1);
+        restore(checkpoints_.back());
+        for (auto i = checkpoints_.back().moves; i < n; i++) {
+            step(rotate_movement(history_[i], rotation_));
+        }
+        history_.truncate(n);
+    }
+
     /**
 	 * @brief 是否通关.
 	 *
@@ -259,16 +268,95 @@ class Level {
 	 * @return false 未通关.
 	 */
     auto passed() const noexcept -> bool {
-        return crate_positions_ == target_positions_;
+        return crates_on_target_ == crate_positions_.size()
+            && crates_on_target_ == target_positions_.size();
+    }
+
+    /**
+	 * @brief 生成以箱子为中心的区域的键, 用于查询死锁模式数据库.
+	 *
+	 * @param position 箱子位置.
+	 */
+    auto deadlock_key(const sf::Vector2i& position) const -> uint64_t {
+        constexpr int radius = DeadlockDatabase::window_size / 2;
+        std::array<uint8_t, DeadlockDatabase::window_area> tiles;
+        auto it = tiles.begin();
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                // 区域可能超出含边框的地图
+                const int x = position.x + 1 + dx, y = position.y + 1 + dy;
+                const bool inside =
+                    x >= 0 && x < stride_ && y >= 0 && y < size().y + 2;
+                *it++ = inside ? map_[y * stride_ + x] : uint8_t(Tile::Wall);
+            }
+        }
+        return DeadlockDatabase::encode(tiles);
+    }
+
+    /**
+	 * @brief 设置死锁模式数据库, 所有关卡共享.
+	 *
+	 * @param database 死锁模式数据库, 为空时不查询.
+	 */
+    static void set_deadlock_database(const DeadlockDatabase* database) {
+        deadlock_database_ = database;
+    }
+
+    static auto deadlock_database() noexcept -> const DeadlockDatabase* {
+        return deadlock_database_;
+    }
+
+    /**
+	 * @brief 重新检查所有箱子死否锁死, 若死锁标记死锁.
+	 *
+	 * @param bitboard 是否在整个地图的位图上匹配死锁模式, 否则逐个检查箱子.
+	 *                 地图宽度超过 62 时总是逐个检查.
+	 */
+    void refresh_deadlocks(bool bitboard = true) {
+        Arena::Scope scope;
+        clear(Tile::Deadlocked);
+        if (!bitboard || stride_ > 64) {
+            for (const auto& crate_pos : crate_positions_) {
+                check_deadlock(crate_pos);
+            }
+            return;
+        }
+        Bitboard crates(stride_, size().y + 2, Arena::resource());
+        for (const auto& crate_pos : crate_positions_) {
+            crates.set(crate_pos.x + 1, crate_pos.y + 1);
+        }
+        deadlock::find_deadlocked_crates(walls_, crates)
+            .for_each([this](int x, int y) {
+                map_[y * stride_ + x] |= Tile::Deadlocked;
+            });
+        if (deadlock_database_ != nullptr) {
+            for (const auto& crate_pos : crate_positions_) {
+                if (!(cell(crate_pos) & Tile::Deadlocked)) {
+                    check_deadlock(crate_pos);
+                }
+            }
+        }
+    }
+
+    /**
+	 * @brief 获取位于目标点上的箱子数量.
+	 */
+    auto crates_on_target() const noexcept -> size_t {
+        return crates_on_target_;
     }
 
     /**
 	 * @brief 渲染地图.
 	 *
-	 * @param target   渲染目标.
-	 * @param material 材质.
+	 * @param target    渲染目标.
+	 * @param material  材质.
+	 * @param animation 最近一步移动的动画状态.
 	 */
-    void render(sf::RenderTarget& target, const Material& material) const {
+    void render(
+        sf::RenderTarget& target,
+        const Material& material,
+        const Animation& animation = {}
+    ) const {
         const sf::Vector2i player_dir =
             rotate_direction(player_direction_, rotation_);
 
@@ -294,6 +382,13 @@ class Level {
         const auto map_size = origin_map_size * scale;
 
         const auto offset = target_center - map_size / 2.f;
+
+        // 移动中的角色和箱子在地图渲染完毕后再绘制, 避免被相邻图块覆盖
+        const bool animating = animation.active();
+        const auto moving_crate_pos = player_position_ + animation.direction;
+        const bool crate_animating = animating && animation.push
+                                  && (at(moving_crate_pos) & Tile::Crate);
+
         for (int y = 0; y < size().y; y++) {
             for (int x = 0; x < size().x; x++) {
                 sf::Sprite sprite(material.texture);
@@ -310,6 +405,12 @@ class Level {
                     tiles &= ~Tile::Floor;
                 }
 
+                const sf::Vector2i pos = {x, y};
+                if ((animating && pos == player_position_)
+                    || (crate_animating && pos == moving_crate_pos)) {
+                    tiles &= ~(Tile::Player | Tile::Crate | Tile::Deadlocked);
+                }
+
                 switch (tiles & ~(Tile::PlayerMovable | Tile::CrateMovable)) {
                     case Tile::Wall:
                         material.set_texture(sprite, Tile::Wall);
@@ -359,22 +460,52 @@ class Level {
                 }
             }
         }
+
+        if (!animating) {
+            return;
+        }
+        const auto shift =
+            sf::Vector2f(animation.direction) * (animation.progress - 1.f);
+        auto moving_sprite = [&](const sf::Vector2i& pos) {
+            sf::Sprite sprite(material.texture);
+            sprite.setScale({scale, scale});
+            sprite.setPosition(
+                {(pos.x + shift.x) * tile_size.x + offset.x,
+                 (pos.y + shift.y) * tile_size.y + offset.y}
+            );
+            return sprite;
+        };
+        if (crate_animating) {
+            auto sprite = moving_sprite(moving_crate_pos);
+            if (at(moving_crate_pos) & Tile::Target) {
+                sprite.setColor(sf::Color(0, 255, 0));
+            } else if (at(moving_crate_pos) & Tile::Deadlocked) {
+                sprite.setColor(sf::Color(255, 0, 0));
+            }
+            material.set_texture(sprite, Tile::Crate);
+            target.draw(sprite);
+        }
+        auto sprite = moving_sprite(player_position_);
+        material.set_texture_player(sprite, player_dir);
+        target.draw(sprite);
     }
 
     void transpose() {
         {
+            // 边框同样会被转置, 因此直接转置含边框的地图
+            const sf::Vector2i padded_size = {stride_, size().y + 2};
             std::vector<uint8_t> temp(map_.size());
-            for (int n = 0; n < size().x * size().y; n++) {
-                const int i = n / size().y;
-                const int j = n % size().y;
-                temp[n] = map_[size().x * j + i];
+            for (int n = 0; n < padded_size.x * padded_size.y; n++) {
+                const int i = n / padded_size.y;
+                const int j = n % padded_size.y;
+                temp[n] = map_[padded_size.x * j + i];
             }
             map_ = temp;
         }
 
         auto transpose = [](auto p) { return sf::Vector2i(p.y, p.x); };
 
-        size_ = transpose(size());
+        set_size(transpose(size()));
         player_position_ = transpose(player_position_);
         {
             std::unordered_set<sf::Vector2i> temp;
@@ -396,6 +527,7 @@ class Level {
             );
             target_positions_ = temp;
         }
+        update_walls();
     }
 
     void rotate() {
@@ -406,10 +538,10 @@ class Level {
     }
 
     void flip() {
-        for (int y = 0; y < size().y; y++)
+        for (int y = 0; y < size().y + 2; y++)
             std::reverse(
-                map_.begin() + y * size().x,
-                map_.begin() + (y + 1) * size().x
+                map_.begin() + y * stride_,
+                map_.begin() + (y + 1) * stride_
             );
 
         auto flip = [center_x = (size().x - 1) / 2.f](auto pos) {
@@ -442,6 +574,7 @@ class Level {
             );
             target_positions_ = temp;
         }
+        update_walls();
 
         // flipped_ = !flipped_;
     }
@@ -459,15 +592,11 @@ class Level {
         const sf::Vector2i& start,
         const sf::Vector2i& end,
         uint8_t border
-    ) -> std::vector<sf::Vector2i> {
+    ) const -> std::vector<sf::Vector2i> {
         struct Node {
-            sf::Vector2i data;
+            int index;
             long priority;
 
-            bool operator==(const Node& rhs) const noexcept {
-                return data == rhs.data;
-            }
-
             bool operator>(const Node& rhs) const noexcept {
                 return priority > rhs.priority;
             }
@@ -478,37 +607,39 @@ class Level {
                 + std::abs(static_cast<long>(a.y) - static_cast<long>(b.y));
         };
 
-        auto euclidean_distance = [](auto a, auto b) {
-            return std::sqrt(
-                std::pow(static_cast<long>(a.x) - static_cast<long>(b.x), 2)
-                + std::pow(static_cast<long>(a.y) - static_cast<long>(b.y), 2)
-            );
-        };
+        if (!in_bounds(start) || !in_bounds(end)) {
+            return {};
+        }
 
-        std::priority_queue<Node, std::vector<Node>, std::greater<>> queue;
-        std::unordered_map<sf::Vector2i, sf::Vector2i> came_from;
-        std::unordered_map<sf::Vector2i, int> cost;
+        // 临时容器从 Arena 中分配, 返回时一次性释放
+        Arena::Scope scope;
+        const auto resource = Arena::resource();
+        std::priority_queue<Node, std::pmr::vector<Node>, std::greater<>> queue(
+            resource
+        );
+        std::pmr::vector<int> came_from(map_.size(), -1, resource);
+        std::pmr::vector<long> cost(map_.size(), -1, resource);
 
-        queue.push({start, 0});
-        cost[start] = 0;
+        const auto start_index = index(start);
+        const auto end_index = index(end);
+        queue.push({start_index, 0});
+        cost[start_index] = 0;
 
-        const sf::Vector2i directions[] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
         while (!queue.empty()) {
             const auto [current, _] = queue.top();
             queue.pop();
-            if (current == end) {
+            if (current == end_index) {
                 break;
             }
-            for (const auto direction : directions) {
-                const auto neighbor = current + direction;
-                if (at(neighbor) & border) {
+            for (const auto offset : offsets_) {
+                const auto neighbor = current + offset;
+                if (map_[neighbor] & border) {
                     continue;
                 }
 
                 const auto neighbor_cost =
-                    cost[current] + manhattan_distance(neighbor, end);
-                if (!cost.contains(neighbor)
-                    || neighbor_cost < cost[neighbor]) {
+                    cost[current] + manhattan_distance(position(neighbor), end);
+                if (cost[neighbor] == -1 || neighbor_cost < cost[neighbor]) {
                     cost[neighbor] = neighbor_cost;
                     came_from[neighbor] = current;
                     queue.push({neighbor, neighbor_cost});
@@ -516,18 +647,15 @@ class Level {
             }
         }
 
-        auto it = came_from.find(end);
-        if (it == came_from.end()) {
+        if (came_from[end_index] == -1) {
             return {};
         }
 
         std::vector<sf::Vector2i> path;
-        path.emplace_back(end);
-        while (it->second != start) {
-            path.emplace_back(it->second);
-            it = came_from.find(it->second);
+        for (auto i = end_index; i != start_index; i = came_from[i]) {
+            path.emplace_back(position(i));
         }
-        path.emplace_back(it->second);
+        path.emplace_back(start);
         std::ranges::reverse(path);
         return path;
     }
@@ -571,17 +699,17 @@ class Level {
     }
 
     auto at(const sf::Vector2i& pos) -> uint8_t& {
-        if (pos.x < 0 || pos.x >= size_.x || pos.y < 0 && pos.y >= size_.y) {
-            throw std::out_of_range("");
+        if (!in_bounds(pos)) {
+            throw std::out_of_range("position out of map");
         }
-        return map_[pos.y * size_.x + pos.x];
+        return map_[index(pos)];
     }
 
     auto at(const sf::Vector2i& pos) const -> uint8_t {
-        if (pos.x < 0 || pos.x >= size_.x || pos.y < 0 && pos.y >= size_.y) {
-            throw std::out_of_range("");
+        if (!in_bounds(pos)) {
+            throw std::out_of_range("position out of map");
         }
-        return map_[pos.y * size_.x + pos.x];
+        return map_[index(pos)];
     }
 
     auto at(int x, int y) -> uint8_t& {
@@ -592,32 +720,42 @@ class Level {
         return at({x, y});
     }
 
+    /**
+	 * @brief 获取含一圈墙壁边框的地图数据.
+	 */
     const auto& map() const noexcept {
         return map_;
     };
 
     const auto& metadata() const noexcept {
-        return metadata_;
+        return *metadata_;
     }
 
     const sf::Vector2i& size() const noexcept {
         return size_;
     };
 
-    const auto& movements() const noexcept {
-        return movements_;
+    const auto& history() const noexcept {
+        return history_;
     }
 
     const auto& player_position() const noexcept {
         return player_position_;
     }
 
-    auto movement() const noexcept {
-        return std::accumulate(
-            movements_.cbegin(),
-            movements_.cend(),
-            std::string()
-        );
+    const auto& target_positions() const noexcept {
+        return target_positions_;
+    }
+
+    auto movement() const {
+        return history_.lurd();
+    }
+
+    /**
+	 * @brief 获取地图相对于初始状态的旋转次数.
+	 */
+    auto rotation() const noexcept -> int {
+        return rotation_;
     }
 
     auto crc32() const noexcept -> uint32_t {
@@ -626,10 +764,19 @@ class Level {
         uint32_t crc = std::numeric_limits<uint32_t>::max();
         // TODO: 计算旋转和镜像共 8 种地图变种的 CRC32
         for (int i = 0; i < 4; i++) {
-            crc = std::min(
-                ::crc32(0, level.map().data(), level.map().size()),
-                crc
-            );
+            // 仅计算边框内的地图本身, 忽略死锁等标记
+            std::vector<uint8_t> map;
+            map.reserve(level.size().x * level.size().y);
+            for (int y = 0; y < level.size().y; y++) {
+                for (int x = 0; x < level.size().x; x++) {
+                    map.push_back(
+                        level.at(x, y)
+                        & (Tile::Floor | Tile::Wall | Tile::Crate
+                           | Tile::Target | Tile::Player)
+                    );
+                }
+            }
+            crc = std::min(::crc32(0, map.data(), map.size()), crc);
             level.rotate();
         }
         return crc;
@@ -681,28 +828,40 @@ class Level {
         return map;
     }
 
-    void fill(const sf::Vector2i& position, uint8_t value, uint8_t border) {
-        std::vector<sf::Vector2i> vector;
-        std::vector<bool> visited(map_.size(), false);
-
-        vector.emplace_back(position);
-
-        while (!vector.empty()) {
-            const auto pos = vector.back();
-            vector.pop_back();
-            at(pos) |= value;
-
-            const sf::Vector2i directions[] =
-                {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
-            for (const auto offset : directions) {
-                if (const auto new_pos = pos + offset;
-                    !(at(new_pos) & (border | value))
-                    && !visited[new_pos.y * size().x + new_pos.x]) {
-                    vector.emplace_back(new_pos);
-                    visited[new_pos.y * size().x + new_pos.x] = true;
+    /**
+	 * @brief 计算从指定位置出发可到达的区域.
+	 *
+	 * 位图坐标与含边框的地图一致, 即地图坐标 (x, y) 对应位 (x + 1, y + 1).
+	 *
+	 * @param position 起始位置.
+	 * @param border   不可通过的图块.
+	 *
+	 * @return 可到达的区域, 以及其中索引最小的位置. 后者可用作角色位置的规范化
+	 *         表示, 角色在同一区域内的任意位置都对应同一规范化位置.
+	 */
+    auto reachable(const sf::Vector2i& position, uint8_t border) const
+        -> std::pair<Bitboard, sf::Vector2i> {
+        const int height = size().y + 2;
+        Bitboard free(stride_, height, Arena::resource());
+        for (int y = 1; y < height - 1; y++) {
+            for (int x = 1; x < stride_ - 1; x++) {
+                if (!(map_[y * stride_ + x] & border)) {
+                    free.set(x, y);
                 }
             }
         }
+        Bitboard seed(stride_, height, Arena::resource());
+        seed.set(position.x + 1, position.y + 1);
+
+        auto area = Bitboard::flood_fill(std::move(seed), free);
+        const auto [x, y] = area.first();
+        return {std::move(area), {x - 1, y - 1}};
+    }
+
+    void fill(const sf::Vector2i& position, uint8_t value, uint8_t border) {
+        Arena::Scope scope;
+        const auto [area, normalized] = reachable(position, border | value);
+        area.for_each([&](int x, int y) { map_[y * stride_ + x] |= value; });
     }
 
     void clear(uint8_t tiles) {
@@ -714,6 +873,13 @@ class Level {
         );
     }
 
+    /**
+	 * @brief 为指定位置添加标记, 例如使用 Tile::CrateMovable 显示提示.
+	 */
+    void mark(const sf::Vector2i& position, uint8_t tiles) {
+        at(position) |= tiles;
+    }
+
     auto calc_crate_movable(const sf::Vector2i& crate_pos) {
         // TODO: 记录访问过的箱子位置, 需要记录可推动的位置, 不能只是箱子位置
         struct Node {
@@ -739,12 +905,12 @@ class Level {
 
         const sf::Vector2i directions[] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
         for (const auto& direction : directions) {
-            if (!(at(crate_pos - direction) & Tile::PlayerMovable)) {
+            if (!(cell(crate_pos - direction) & Tile::PlayerMovable)) {
                 continue;
             }
 
             for (auto pos = crate_pos + direction;
-                 !(at(pos)
+                 !(cell(pos)
                    & (Tile::Unmovable | Tile::Crate | Tile::CrateMovable));
                  pos += direction) {
                 if (came_from.contains(pos)) {
@@ -765,15 +931,21 @@ class Level {
                 }
 
                 came_from[pos] = crate_pos;
-                at(pos) |= Tile::CrateMovable;
+                cell(pos) |= Tile::CrateMovable;
+
+                // 隧道中的箱子无法被横向推动, 向后推动会被已标记的位置阻挡,
+                // 向前推动由当前循环处理, 因此无需递归
+                if (pos - direction != crate_pos && is_tunnel(pos, direction)) {
+                    continue;
+                }
 
-                at(pos - direction) &= ~Tile::Crate;
-                at(pos) |= Tile::Crate;
+                cell(pos - direction) &= ~Tile::Crate;
+                cell(pos) |= Tile::Crate;
 
                 calc_crate_movable(pos, pos - direction, came_from);
 
-                at(pos) &= ~Tile::Crate;
-                at(pos - direction) |= Tile::Crate;
+                cell(pos) &= ~Tile::Crate;
+                cell(pos - direction) |= Tile::Crate;
 
                 clear(Tile::PlayerMovable);
                 fill(player_pos, Tile::PlayerMovable, Tile::Crate | Tile::Wall);
@@ -844,15 +1016,33 @@ class Level {
     }
 
   private:
+    /**
+	 * @brief 检查点, 记录某一步移动后角色和箱子在未旋转地图中的位置.
+	 */
+    struct Checkpoint {
+        size_t moves; // 已执行的移动步数
+        int player;
+        std::vector<int> crates;
+    };
+
     /**
 	 * @brief 解析地图.
 	 *
 	 * @param map XSB 格式地图数据.
 	 */
     void parse_map(const std::string& map, const sf::Vector2i& size) {
-        map_.clear();
-        map_.resize(size.x * size.y);
-        size_ = size;
+        set_size(size);
+        map_.assign(stride_ * (size.y + 2), 0);
+
+        // 地图四周填充一圈墙壁, 使遍历时无需检查边界
+        for (int x = 0; x < stride_; x++) {
+            map_[x] = Tile::Wall;
+            map_[map_.size() - 1 - x] = Tile::Wall;
+        }
+        for (int y = 0; y < size.y + 2; y++) {
+            map_[y * stride_] = Tile::Wall;
+            map_[y * stride_ + stride_ - 1] = Tile::Wall;
+        }
 
         int y = 0;
         std::istringstream stream(map);
@@ -888,6 +1078,7 @@ class Level {
                         at(x, y) |= Tile::Crate | Tile::Target;
                         crate_positions_.emplace(x, y);
                         target_positions_.emplace(x, y);
+                        crates_on_target_++;
                         break;
 
                     case '+':
@@ -910,15 +1101,21 @@ class Level {
         if (size.x + size.y > 0) {
             fill(player_position_, Tile::Floor, Tile::Wall);
         }
+
+        update_walls();
+
+        checkpoints_.clear();
+        save_checkpoint();
     }
 
     /**
 	 * @brief 解析元数据.
 	 *
-	 * @param metadata XSB 格式元数据.
+	 * @param data XSB 格式元数据.
 	 */
-    void parse_metadata(const std::string& metadata) {
-        std::istringstream stream(metadata);
+    void parse_metadata(const std::string& data) {
+        std::unordered_map<std::string, std::string> metadata;
+        std::istringstream stream(data);
         for (std::string line; std::getline(stream, line);) {
             const auto it = line.find(':');
             assert(it != std::string::npos);
@@ -949,8 +1146,11 @@ class Level {
                 }
             }
 
-            metadata_.emplace(key, value);
+            metadata.emplace(key, value);
         }
+        metadata_ = std::make_shared<const decltype(metadata)>(
+            std::move(metadata)
+        );
     }
 
     /**
@@ -962,107 +1162,24 @@ class Level {
 	 * @return false 箱子不一定锁死.
 	 */
     auto is_crate_deadlocked(const sf::Vector2i& position) const -> bool {
-        assert(at(position) & Tile::Crate);
-
-        // #$
-        //  #
-        {
-            const sf::Vector2i directions[4] =
-                {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
-            for (size_t i = 0; i < 4; i++) {
-                if ((at(position + directions[i]) & Tile::Unmovable)
-                    && (at(position + directions[(i + 1) % 4]) & Tile::Unmovable
-                    )) {
-                    return true;
-                }
-            }
-        }
-
-        // $$
-        // ##
-        {
-            const sf::Vector2i directions[8] = {
-                {0, -1},
-                {1, -1},
-                {1, 0},
-                {1, 1},
-                {0, 1},
-                {-1, 1},
-                {-1, 0},
-                {-1, -1}
-            };
-            for (size_t i = 0; i < 8; i += 2) {
-                if ((at(position + directions[i]) & Tile::Crate)
-                    && (at(position + directions[i + 1])
-                        & at(position + directions[(i + 2) % 8])
-                        & Tile::Unmovable)) {
-                    {
-                        return true;
-                    }
-                }
-                if ((at(position + directions[i])
-                     & at(position + directions[i + 1]) & Tile::Unmovable)
-                    && (at(position + directions[(i + 2) % 8]) & Tile::Crate)) {
-                    {
-                        return true;
-                    }
-                }
-            }
-        }
-
-        // FIXME
-        // #      #
-        // $$  $# $$   $#
-        //  # #$   #  #$
-        {
-            // clang-format off
-			const sf::Vector2i directions[24] = {
-				{0,  -1}, { 1, 1}, { 1,  0},
-				{1,   0}, {-1, 1}, { 0,  1},
-				{-1, -1}, { 0, 1}, {-1,  0},
-				{0,  -1}, {-1, 1}, { 0, -1},
-
-				{-1, -1}, { 0, -1}, {-1,  0},
-				{ 1, -1}, {-1,  0}, { 0, -1},
-				{ 0, -1}, { 1,  1}, { 1,  0},
-				{ 1,  0}, {-1,  1}, { 0,  1}
-			};
-            // clang-format on
-            for (size_t i = 0; i < 24; i += 3) {
-                if (at(position + directions[i])
-                        & at(position + directions[i + 1]) & Tile::Unmovable
-                    && at(position + directions[i + 2]) & Tile::Crate) {
-                    {
-                        return true;
-                    }
-                }
-            }
-        }
-
-        // $X
-        // XX
-        {
-            const sf::Vector2i directions[8] = {
-                {0, -1},
-                {1, -1},
-                {1, 0},
-                {1, 1},
-                {0, 1},
-                {-1, 1},
-                {-1, 0},
-                {-1, -1}
-            };
-            for (size_t i = 0; i < 8; i += 2) {
-                if (at(position + directions[i])
-                    & at(position + directions[i + 1])
-                    & at(position + directions[(i + 2) % 8])
-                    & (Tile::Unmovable | Tile::Crate)) {
-                    return true;
-                }
-            }
-        }
+        assert(cell(position) & Tile::Crate);
+        return deadlock::match([&](auto tile) {
+                   constexpr deadlock::Cell c = tile;
+                   return (cell(position + sf::Vector2i(c.x, c.y))
+                           & deadlock::tiles(c.kind))
+                       != 0;
+               })
+            != 0;
+    }
 
-        return false;
+    /**
+	 * @brief 检查箱子所在区域是否记录在死锁模式数据库中.
+	 *
+	 * @param position 箱子位置.
+	 */
+    auto is_known_deadlock(const sf::Vector2i& position) const -> bool {
+        return deadlock_database_ != nullptr
+            && deadlock_database_->contains(deadlock_key(position));
     }
 
     /**
@@ -1071,39 +1188,240 @@ class Level {
 	 * @param position 箱子位置.
 	 */
     void check_deadlock(const sf::Vector2i& position) {
-        if (!is_crate_deadlocked(position)) {
+        if (!is_crate_deadlocked(position) && !is_known_deadlock(position)) {
             return;
         }
-        at(position) |= Tile::Deadlocked;
-        const sf::Vector2i directions[4] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+        cell(position) |= Tile::Deadlocked;
+        // 死锁模式会涉及对角线上的图块, 因此需要检查周围的 8 个箱子
+        const sf::Vector2i directions[8] = {
+            {0, -1},
+            {1, -1},
+            {1, 0},
+            {1, 1},
+            {0, 1},
+            {-1, 1},
+            {-1, 0},
+            {-1, -1}
+        };
         for (const auto direction : directions) {
-            if (at(position + direction) & Tile::Crate
-                && !(at(position + direction) & Tile::Deadlocked)) {
+            if (cell(position + direction) & Tile::Crate
+                && !(cell(position + direction) & Tile::Deadlocked)) {
                 check_deadlock(position + direction);
             }
         }
     }
 
     /**
-	 * @brief 重新检查所有箱子死否锁死, 若死锁标记死锁.
+	 * @brief 设置地图大小, 并更新行跨度和各方向的索引偏移.
+	 *
+	 * @param size 不含边框的地图大小.
 	 */
-    void refresh_deadlocks() {
-        clear(Tile::Deadlocked);
+    void set_size(const sf::Vector2i& size) {
+        size_ = size;
+        stride_ = size.x + 2;
+        offsets_ = {-stride_, stride_, -1, 1};
+    }
+
+    auto in_bounds(const sf::Vector2i& pos) const noexcept -> bool {
+        return pos.x >= 0 && pos.x < size_.x && pos.y >= 0 && pos.y < size_.y;
+    }
+
+    /**
+	 * @brief 获取坐标在含边框地图中的索引.
+	 *
+	 * 坐标可以位于边框上, 即范围为 [-1, size].
+	 */
+    auto index(const sf::Vector2i& pos) const noexcept -> int {
+        return (pos.y + 1) * stride_ + pos.x + 1;
+    }
+
+    auto position(int index) const noexcept -> sf::Vector2i {
+        return {index % stride_ - 1, index / stride_ - 1};
+    }
+
+    /**
+	 * @brief 获取方向对应的索引偏移.
+	 */
+    auto offset(const sf::Vector2i& direction) const noexcept -> int {
+        return direction.y * stride_ + direction.x;
+    }
+
+    /**
+	 * @brief 不检查边界的访问, 坐标必须位于地图或边框内.
+	 */
+    auto cell(const sf::Vector2i& pos) noexcept -> uint8_t& {
+        assert(pos.x >= -1 && pos.x <= size_.x);
+        assert(pos.y >= -1 && pos.y <= size_.y);
+        return map_[index(pos)];
+    }
+
+    auto cell(const sf::Vector2i& pos) const noexcept -> uint8_t {
+        assert(pos.x >= -1 && pos.x <= size_.x);
+        assert(pos.y >= -1 && pos.y <= size_.y);
+        return map_[index(pos)];
+    }
+
+    /**
+	 * @brief 判断位置是否为隧道, 即垂直于方向的两侧均为墙壁.
+	 */
+    auto is_tunnel(const sf::Vector2i& pos, const sf::Vector2i& direction) const
+        -> bool {
+        const sf::Vector2i normal(direction.y, direction.x);
+        return (cell(pos + normal) & Tile::Wall)
+            && (cell(pos - normal) & Tile::Wall);
+    }
+
+    /**
+	 * @brief 执行一步移动, 不记录.
+	 *
+	 * @param move LURD 格式移动.
+	 *
+	 * @return char 未旋转地图中的 LURD 格式移动, 无法移动时返回 '\0'.
+	 */
+    auto step(char move) -> char {
+        const auto direction = movement_to_direction(move);
+        const auto offset = this->offset(direction);
+        const auto player = index(player_position_);
+        const auto player_next = player + offset;
+        player_direction_ = direction;
+        if (map_[player_next] & Tile::Wall) {
+            return '\0';
+        }
+        const bool push = map_[player_next] & Tile::Crate;
+        if (push) {
+            const auto crate_next = player_next + offset;
+            if (map_[crate_next] & (Tile::Wall | Tile::Crate)) {
+                return '\0';
+            }
+
+            crates_on_target_ -= (map_[player_next] & Tile::Target) != 0;
+            crates_on_target_ += (map_[crate_next] & Tile::Target) != 0;
+            // 数据库中的死锁区域不一定冻结箱子, 被标记的箱子仍可能被推动
+            map_[player_next] &= ~(Tile::Crate | Tile::Deadlocked);
+            map_[crate_next] |= Tile::Crate;
+            crate_positions_.erase(player_position_ + direction);
+            crate_positions_.insert(player_position_ + direction + direction);
+            check_deadlock(player_position_ + direction + direction);
+        }
+        map_[player] &= ~Tile::Player;
+        map_[player_next] |= Tile::Player;
+        player_position_ += direction;
+
+        return rotate_movement(
+            push ? std::toupper(move) : std::tolower(move),
+            -rotation_
+        );
+    }
+
+    /**
+	 * @brief 将当前状态保存为检查点.
+	 */
+    void save_checkpoint() {
+        Checkpoint checkpoint;
+        checkpoint.moves = history_.size();
+        checkpoint.player = to_base_index(player_position_);
+        checkpoint.crates.reserve(crate_positions_.size());
         for (const auto& crate_pos : crate_positions_) {
-            check_deadlock(crate_pos);
+            checkpoint.crates.push_back(to_base_index(crate_pos));
         }
+        checkpoints_.emplace_back(std::move(checkpoint));
+    }
+
+    /**
+	 * @brief 从检查点恢复角色和箱子的位置.
+	 *
+	 * @param checkpoint 检查点.
+	 */
+    void restore(const Checkpoint& checkpoint) {
+        clear(Tile::Player | Tile::Crate | Tile::Deadlocked);
+        crate_positions_.clear();
+        crates_on_target_ = 0;
+        for (const auto index : checkpoint.crates) {
+            const auto crate_pos = from_base_index(index);
+            cell(crate_pos) |= Tile::Crate;
+            crate_positions_.insert(crate_pos);
+            crates_on_target_ += (cell(crate_pos) & Tile::Target) != 0;
+        }
+        player_position_ = from_base_index(checkpoint.player);
+        cell(player_position_) |= Tile::Player;
+        refresh_deadlocks();
+    }
+
+    /**
+	 * @brief 将当前坐标转换为未旋转地图中的索引.
+	 */
+    auto to_base_index(sf::Vector2i pos) const -> int {
+        auto size = size_;
+        for (int i = rotation_; i % 4 != 0; i++) {
+            pos = {size.y - 1 - pos.y, pos.x};
+            size = {size.y, size.x};
+        }
+        return pos.y * size.x + pos.x;
+    }
+
+    /**
+	 * @brief 将未旋转地图中的索引转换为当前坐标.
+	 */
+    auto from_base_index(int index) const -> sf::Vector2i {
+        auto size = rotation_ % 2 ? sf::Vector2i(size_.y, size_.x) : size_;
+        sf::Vector2i pos = {index % size.x, index / size.x};
+        for (int i = 0; i < rotation_; i++) {
+            pos = {size.y - 1 - pos.y, pos.x};
+            size = {size.y, size.x};
+        }
+        return pos;
+    }
+
+    /**
+	 * @brief 更新墙壁位图, 地图结构改变后需要调用.
+	 */
+    void update_walls() {
+        walls_ = stride_ <= 64 ? plane(Tile::Wall) : Bitboard();
+    }
+
+    /**
+	 * @brief 生成含边框地图的位图, 地图宽度不能超过 64.
+	 *
+	 * @param tiles 图块.
+	 *
+	 * @return Bitboard 包含任意指定图块的位置.
+	 */
+    auto plane(uint8_t tiles) const -> Bitboard {
+        assert(stride_ <= 64);
+        const int height = size().y + 2;
+        Bitboard plane(stride_, height);
+        auto& rows = plane.words();
+        for (int y = 0; y < height; y++) {
+            uint64_t row = 0;
+            for (int x = 0; x < stride_; x++) {
+                row |= uint64_t((map_[y * stride_ + x] & tiles) != 0) << x;
+            }
+            rows[y] = row;
+        }
+        return plane;
     }
 
     sf::Vector2i size_;
+    int stride_ = 2; // 含边框的地图宽度
+    std::array<int, 4> offsets_ = {-2, 2, -1, 1}; // 上下左右的索引偏移
+    Bitboard walls_; // 含边框地图的墙壁位图
+
+    static inline const DeadlockDatabase* deadlock_database_ = nullptr;
     std::vector<uint8_t> map_;
-    std::unordered_map<std::string, std::string> metadata_;
+    // 元数据在解析后不再改变, 由关卡的副本共享
+    std::shared_ptr<const std::unordered_map<std::string, std::string>>
+        metadata_;
 
     sf::Vector2i player_direction_ = {0, 1};
     sf::Vector2i player_position_;
     std::unordered_set<sf::Vector2i> crate_positions_;
     std::unordered_set<sf::Vector2i> target_positions_;
+    size_t crates_on_target_ = 0;
+
+    static constexpr size_t checkpoint_interval = 64;
 
-    std::vector<std::string> movements_;
+    History history_;
+    std::vector<Checkpoint> checkpoints_;
 
     int rotation_ = 0;
     bool flipped_ = false;
@@ -0,0 +1,86 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "level.hpp"
+
+/**
+ * @brief 已解析关卡的 LRU 缓存.
+ *
+ * 以关卡 ID 为键, 缓存不可变的已解析关卡. 每个条目记录关卡的指纹, 指纹不同时
+ * 条目被视为过期, 因此数据库中的关卡或答案改变后不会取得旧的关卡.
+ */
+class LevelCache {
+  public:
+    explicit LevelCache(size_t capacity = 32) : capacity_(capacity) {}
+
+    /**
+	 * @brief 获取缓存的关卡.
+	 *
+	 * @param id          关卡 ID.
+	 * @param fingerprint 关卡的指纹.
+	 *
+	 * @return 未缓存或已过期时返回 nullptr.
+	 */
+    auto get(int id, uint64_t fingerprint) -> std::shared_ptr<const Level> {
+        std::lock_guard lock(mutex_);
+        const auto it = entries_.find(id);
+        if (it == entries_.end()) {
+            return nullptr;
+        }
+        if (it->second->fingerprint != fingerprint) {
+            order_.erase(it->second);
+            entries_.erase(it);
+            return nullptr;
+        }
+        order_.splice(order_.begin(), order_, it->second);
+        return it->second->level;
+    }
+
+    /**
+	 * @brief 缓存关卡, 超出容量时移除最久未使用的关卡.
+	 *
+	 * @param id          关卡 ID.
+	 * @param fingerprint 关卡的指纹.
+	 * @param level       关卡.
+	 */
+    void put(int id, uint64_t fingerprint, Level level) {
+        std::lock_guard lock(mutex_);
+        if (const auto it = entries_.find(id); it != entries_.end()) {
+            order_.erase(it->second);
+            entries_.erase(it);
+        }
+        order_.push_front(
+            {id,
+             fingerprint,
+             std::make_shared<const Level>(std::move(level))}
+        );
+        entries_.emplace(id, order_.begin());
+        if (order_.size() > capacity_) {
+            entries_.erase(order_.back().id);
+            order_.pop_back();
+        }
+    }
+
+  private:
+    struct Entry {
+        int id;
+        uint64_t fingerprint;
+        std::shared_ptr<const Level> level;
+    };
+
+    size_t capacity_;
+
+    std::mutex mutex_;
+    std::list<Entry> order_; // 最近使用的条目在前
+    std::unordered_map<int, std::list<Entry>::iterator> entries_;
+};
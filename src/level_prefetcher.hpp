@@ -0,0 +1,130 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+#include "database.hpp"
+#include "level.hpp"
+
+/**
+ * @brief 关卡预加载器, 在后台线程中加载指定关卡之后第一个没有答案的关卡.
+ *
+ * 后台线程在构造时启动, 并在整个生命周期内复用同一个数据库连接, 因此切换
+ * 关卡时无需重新打开数据库. 新的请求会使之前的请求失效.
+ */
+class LevelPrefetcher {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param database_path 数据库路径.
+	 */
+    explicit LevelPrefetcher(std::filesystem::path database_path) :
+        database_path_(std::move(database_path)),
+        thread_([this](const std::stop_token& token) { run(token); }) {}
+
+    ~LevelPrefetcher() {
+        stop();
+    }
+
+    LevelPrefetcher(const LevelPrefetcher&) = delete;
+    LevelPrefetcher& operator=(const LevelPrefetcher&) = delete;
+
+    /**
+	 * @brief 请求预加载关卡, 之前加载的关卡被丢弃.
+	 *
+	 * @param id 关卡 ID, 预加载其后第一个没有答案的关卡.
+	 */
+    void request(int id) {
+        std::lock_guard lock(mutex_);
+        pending_ = id;
+        level_.reset();
+        condition_.notify_all();
+    }
+
+    /**
+	 * @brief 获取预加载的关卡, 尚未加载完成时等待.
+	 *
+	 * @return 没有符合条件的关卡, 加载失败或后台线程已停止时返回
+	 *         std::nullopt, 此时应同步加载.
+	 */
+    auto take() -> std::optional<Level> {
+        std::unique_lock lock(mutex_);
+        condition_.wait(lock, [this] {
+            return (!pending_.has_value() && !loading_) || stopped_;
+        });
+        return std::exchange(level_, std::nullopt);
+    }
+
+    /**
+	 * @brief 停止后台线程.
+	 */
+    void stop() {
+        if (thread_.joinable()) {
+            thread_.request_stop();
+            thread_.join();
+        }
+    }
+
+  private:
+    void run(const std::stop_token& token) {
+        // 后台线程使用独立的数据库连接, 打开失败时所有请求均回退到同步加载
+        std::optional<Database> database;
+        try {
+            database.emplace(database_path_);
+        } catch (const SQLite::Exception&) {
+        }
+        while (true) {
+            int id;
+            {
+                std::unique_lock lock(mutex_);
+                if (!condition_.wait(lock, token, [this] {
+                        return pending_.has_value();
+                    })) {
+                    stopped_ = true;
+                    condition_.notify_all();
+                    return;
+                }
+                id = *std::exchange(pending_, std::nullopt);
+                loading_ = true;
+            }
+
+            std::optional<Level> level;
+            if (database.has_value()) {
+                try {
+                    const auto next = database->get_next_unsolved_level_id(id);
+                    if (next.has_value()) {
+                        level = database->get_level_by_id(next.value());
+                    }
+                } catch (const SQLite::Exception&) {
+                }
+            }
+
+            std::lock_guard lock(mutex_);
+            loading_ = false;
+            if (!pending_.has_value()) {
+                level_ = std::move(level);
+            }
+            condition_.notify_all();
+        }
+    }
+
+    std::filesystem::path database_path_;
+
+    std::mutex mutex_;
+    std::condition_variable_any condition_;
+    std::optional<int> pending_;
+    bool loading_ = false;
+    bool stopped_ = false;
+    std::optional<Level> level_;
+
+    std::jthread thread_;
+};
@@ -0,0 +1,150 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/**
+ * @brief 只读内存映射文件.
+ */
+class MappedFile {
+  public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+        file_ = CreateFileW(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("failed to open file");
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size)) {
+            close();
+            throw std::runtime_error("failed to get file size");
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0) {
+            return;
+        }
+        mapping_ =
+            CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_ == nullptr) {
+            close();
+            throw std::runtime_error("failed to map file");
+        }
+        data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        if (data_ == nullptr) {
+            close();
+            throw std::runtime_error("failed to map file");
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("failed to open file");
+        }
+        struct stat status;
+        if (::fstat(fd, &status) == -1) {
+            ::close(fd);
+            throw std::runtime_error("failed to get file size");
+        }
+        size_ = static_cast<size_t>(status.st_size);
+        if (size_ > 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("failed to map file");
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    auto operator=(MappedFile&& other) noexcept -> MappedFile& {
+        if (this != &other) {
+            close();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+            file_ = std::exchange(other.file_, INVALID_HANDLE_VALUE);
+            mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    auto data() const noexcept -> const std::byte* {
+        return static_cast<const std::byte*>(data_);
+    }
+
+    auto size() const noexcept -> size_t {
+        return size_;
+    }
+
+  private:
+    void close() noexcept {
+#ifdef _WIN32
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+    void* data_ = nullptr;
+#else
+    void* data_ = nullptr;
+#endif
+    size_t size_ = 0;
+};
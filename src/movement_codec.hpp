@@ -0,0 +1,129 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 移动记录的压缩存储格式.
+ *
+ * 每步移动占用 3 位: 低 2 位为方向 (udlr), 第 3 位表示是否推动箱子. 编码由
+ * 字节组成, 最高位区分两种字节:
+ *
+ * - 0b0cbbbaaa: 一至两步移动 a, b, c 为 1 时包含第二步 b.
+ * - 0b1nnnnaaa: 连续 n + 3 步相同的移动 a, 即 3 至 18 步.
+ *
+ * 沿走廊行走和连续推动通常由相同的移动组成, 其余移动每字节存储两步. 单独存储
+ * 的一步之后总是跟随至少 3 步连续移动, 因此 n 步移动的编码不超过 ⌈n/2⌉ 字节.
+ */
+namespace movement_codec {
+
+inline constexpr size_t min_run = 3;
+inline constexpr size_t max_run = min_run + 0b1111;
+
+inline auto encode(char move) -> uint8_t {
+    uint8_t bits;
+    switch (std::tolower(move)) {
+        case 'u':
+            bits = 0;
+            break;
+
+        case 'd':
+            bits = 1;
+            break;
+
+        case 'l':
+            bits = 2;
+            break;
+
+        case 'r':
+            bits = 3;
+            break;
+
+        default:
+            throw std::invalid_argument("invalid movement");
+    }
+    return std::isupper(move) ? bits | 0b100 : bits;
+}
+
+inline auto decode(uint8_t bits) -> char {
+    const auto move = "udlr"[bits & 0b11];
+    return bits & 0b100 ? static_cast<char>(std::toupper(move)) : move;
+}
+
+} // namespace movement_codec
+
+/**
+ * @brief 压缩移动记录.
+ *
+ * @param movement LURD 格式移动记录, 如 std::string 或 History.
+ */
+template <class Movement>
+auto encode_movement(const Movement& movement) -> std::vector<uint8_t> {
+    using namespace movement_codec;
+    const size_t size = movement.size();
+    const auto run = [&](size_t begin) {
+        auto end = begin + 1;
+        while (end < size && end - begin < max_run
+               && movement[end] == movement[begin]) {
+            end++;
+        }
+        return end - begin;
+    };
+
+    std::vector<uint8_t> data;
+    data.reserve((size + 1) / 2);
+    for (size_t i = 0; i < size;) {
+        if (const auto length = run(i); length >= min_run) {
+            data.push_back(static_cast<uint8_t>(
+                0x80 | (length - min_run) << 3 | encode(movement[i])
+            ));
+            i += length;
+            continue;
+        }
+        // 下一步开始连续移动时单独存储当前移动
+        if (i + 1 == size || run(i + 1) >= min_run) {
+            data.push_back(encode(movement[i]));
+            i++;
+            continue;
+        }
+        data.push_back(static_cast<uint8_t>(
+            0x40 | encode(movement[i + 1]) << 3 | encode(movement[i])
+        ));
+        i += 2;
+    }
+    return data;
+}
+
+/**
+ * @brief 解压移动记录.
+ *
+ * @param data 压缩的移动记录.
+ * @param size 字节数.
+ *
+ * @return LURD 格式移动记录.
+ */
+inline auto decode_movement(const uint8_t* data, size_t size) -> std::string {
+    using namespace movement_codec;
+    std::string movement;
+    movement.reserve(size * 2);
+    for (size_t i = 0; i < size; i++) {
+        const auto byte = data[i];
+        const auto move = decode(byte);
+        if (byte & 0x80) {
+            movement.append(((byte >> 3) & 0b1111) + min_run, move);
+            continue;
+        }
+        movement.push_back(move);
+        if (byte & 0x40) {
+            movement.push_back(decode(byte >> 3));
+        }
+    }
+    return movement;
+}
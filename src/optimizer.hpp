@@ -0,0 +1,418 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "level.hpp"
+#include "tile.hpp"
+
+/**
+ * @brief 解的后处理优化器.
+ *
+ * 在保持解有效的前提下减少移动次数, 移动次数相同时减少推动次数. 优化器沿解
+ * 滑动窗口, 窗口从一次推动之后开始, 到之后某次推动之前角色所在的位置结束,
+ * 窗口内只允许推动窗口中被推动过的箱子, 并搜索窗口起止状态间代价最小的移动:
+ *
+ * - 窗口中没有推动时, 即以最短路径重新规划角色的行走.
+ * - 窗口中有多个箱子时, 互不影响的推动可以被重新排序.
+ * - 窗口中的箱子可以以推动次数更少的方式到达相同的位置.
+ *
+ * 每个窗口的搜索节点数受限, 超出时缩小窗口, 重复直至没有改进, 因此得到的是
+ * 局部最优解.
+ */
+class Optimizer {
+  public:
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param level 关卡, 从其当前状态开始执行解.
+	 */
+    explicit Optimizer(const Level& level) : rotation_(level.rotation()) {
+        Level base(level);
+        while (base.rotation() != 0) {
+            base.rotate();
+        }
+        stride_ = base.size().x + 2;
+        offsets_ = {-stride_, stride_, -1, 1};
+        const auto& map = base.map();
+        tiles_.resize(map.size());
+        for (size_t i = 0; i < map.size(); i++) {
+            tiles_[i] = map[i] & (Tile::Wall | Tile::Crate | Tile::Target);
+        }
+        const auto& player = base.player_position();
+        player_ = (player.y + 1) * stride_ + player.x + 1;
+    }
+
+    /**
+	 * @brief 设置每个窗口的搜索节点数上限.
+	 */
+    void set_node_limit(size_t nodes) noexcept {
+        node_limit_ = nodes;
+    }
+
+    /**
+	 * @brief 设置每个窗口中被推动的箱子数的上限.
+	 */
+    void set_max_crates(int crates) noexcept {
+        max_crates_ = std::max(crates, 1);
+    }
+
+    /**
+	 * @brief 优化解.
+	 *
+	 * @param solution LURD 格式的解, 与关卡的方向相同.
+	 *
+	 * @return 优化后的解, 不差于原解. 原解无效时返回 std::nullopt.
+	 */
+    auto optimize(const std::string& solution) const
+        -> std::optional<std::string> {
+        std::string moves;
+        for (const auto move : solution) {
+            if (direction(move) == -1) {
+                return std::nullopt;
+            }
+            moves += rotate_movement(move, -rotation_);
+        }
+        if (!is_solution(moves)) {
+            return std::nullopt;
+        }
+
+        while (improve(moves)) {
+        }
+
+        for (auto& move : moves) {
+            move = rotate_movement(move, rotation_);
+        }
+        return moves;
+    }
+
+  private:
+    /**
+	 * @brief 执行移动时的状态.
+	 */
+    struct State {
+        std::vector<uint8_t> tiles; // 含箱子的地图
+        int player;
+
+        /**
+		 * @brief 执行一次移动.
+		 *
+		 * @return 移动不合法或推动与大小写不符时返回 false.
+		 */
+        auto step(int offset, bool push) -> bool {
+            const auto next = player + offset;
+            if (tiles[next] & Tile::Wall) {
+                return false;
+            }
+            if (static_cast<bool>(tiles[next] & Tile::Crate) != push) {
+                return false;
+            }
+            if (push) {
+                if (tiles[next + offset] & (Tile::Wall | Tile::Crate)) {
+                    return false;
+                }
+                tiles[next] &= ~Tile::Crate;
+                tiles[next + offset] |= Tile::Crate;
+            }
+            player = next;
+            return true;
+        }
+    };
+
+    /**
+	 * @brief 窗口内搜索的节点.
+	 */
+    struct Node {
+        int parent;
+        char move;
+        int moves;
+        int pushes;
+    };
+
+    /**
+	 * @brief 对解执行一轮滑动窗口优化.
+	 *
+	 * @return 是否有改进.
+	 */
+    auto improve(std::string& moves) const -> bool {
+        bool improved = false;
+        State state {tiles_, player_};
+        size_t start = 0; // 窗口的起点, state 为执行 moves[start] 前的状态
+        for (;;) {
+            std::vector<size_t> pushes;
+            for (auto i = start; i < moves.size(); i++) {
+                if (std::isupper(moves[i])) {
+                    pushes.push_back(i);
+                }
+            }
+
+            // 窗口依次包含之后的推动, 直至被推动的箱子数超出上限.
+            // 窗口终点为某次推动前角色所在的位置, 或包含所有推动时为终局
+            std::vector<size_t> ends;
+            {
+                State copy = state;
+                std::unordered_map<int, int> origins; // 箱子位置到起点的映射
+                int crates = 0;
+                auto position = start;
+                bool complete = true;
+                for (const auto push : pushes) {
+                    for (; position < push; position++) {
+                        copy.step(offsets_[direction(moves[position])], false);
+                    }
+                    ends.push_back(push);
+                    const auto offset = offsets_[direction(moves[push])];
+                    const auto crate = copy.player + offset;
+                    auto origin = crate;
+                    if (const auto it = origins.find(crate);
+                        it != origins.end()) {
+                        origin = it->second;
+                        origins.erase(it);
+                    } else if (++crates > max_crates_) {
+                        complete = false;
+                        break;
+                    }
+                    origins[crate + offset] = origin;
+                    copy.step(offset, true);
+                    position = push + 1;
+                }
+                if (complete) {
+                    ends.push_back(moves.size());
+                }
+            }
+
+            // 窗口过大导致搜索超出节点上限时, 缩小窗口
+            for (auto count = ends.size(); count > 0; count /= 2) {
+                const auto end = ends[count - 1];
+                const auto result = search(state, moves, start, end);
+                if (!result.has_value()) {
+                    continue;
+                }
+                if (cost(*result, 0, result->size())
+                    < cost(moves, start, end)) {
+                    moves.replace(start, end - start, *result);
+                    improved = true;
+                }
+                break;
+            }
+
+            // 移动至下一次推动之后
+            const auto next = moves.find_first_of("UDLR", start);
+            if (next == std::string::npos) {
+                break;
+            }
+            for (; start <= next; start++) {
+                state.step(
+                    offsets_[direction(moves[start])],
+                    std::isupper(moves[start])
+                );
+            }
+        }
+        return improved;
+    }
+
+    /**
+	 * @brief 搜索窗口起止状态间代价最小的移动.
+	 *
+	 * 以移动次数为主, 推动次数为辅的代价进行 A* 搜索, 启发函数为角色与终点的
+	 * 曼哈顿距离. 代价超过原移动的节点被剪去.
+	 *
+	 * @param state 窗口起点的状态.
+	 * @param moves 移动.
+	 * @param start 窗口起点.
+	 * @param end   窗口终点, 为 moves.size() 时终点为终局.
+	 *
+	 * @return 超出节点上限时返回 std::nullopt.
+	 */
+    auto search(
+        const State& state,
+        const std::string& moves,
+        size_t start,
+        size_t end
+    ) const -> std::optional<std::string> {
+        // 窗口终点的状态和窗口中被推动的箱子
+        State goal = state;
+        std::vector<uint8_t> movable(state.tiles.size(), false);
+        for (auto i = start; i < end; i++) {
+            const auto offset = offsets_[direction(moves[i])];
+            if (std::isupper(moves[i])) {
+                movable[goal.player + offset] = true;
+            }
+            goal.step(offset, std::isupper(moves[i]));
+        }
+        const auto goal_player = end == moves.size() ? -1 : goal.player;
+        const auto bound = static_cast<int>(end - start);
+
+        // 未被推动的箱子视为墙壁, 状态只包含被推动的箱子和角色位置
+        std::vector<uint8_t> tiles(state.tiles.size());
+        std::u16string key, goal_key;
+        for (size_t i = 0; i < tiles.size(); i++) {
+            const bool crate = state.tiles[i] & Tile::Crate;
+            tiles[i] = state.tiles[i] & Tile::Wall;
+            if (crate && !movable[i]) {
+                tiles[i] |= Tile::Wall;
+            }
+            if (crate && movable[i]) {
+                key += static_cast<char16_t>(i);
+            }
+            if ((goal.tiles[i] & Tile::Crate) && !(tiles[i] & Tile::Wall)) {
+                goal_key += static_cast<char16_t>(i);
+            }
+        }
+        const auto crates = key.size();
+        key += static_cast<char16_t>(state.player);
+
+        const auto heuristic = [&](int player) {
+            if (goal_player == -1) {
+                return 0;
+            }
+            return std::abs(player % stride_ - goal_player % stride_)
+                 + std::abs(player / stride_ - goal_player / stride_);
+        };
+
+        std::vector<Node> nodes {{-1, '\0', 0, 0}};
+        std::vector<std::u16string> keys {key};
+        std::unordered_map<std::u16string, int> visited {{key, 0}};
+        using Entry = std::array<int, 3>; // f, 推动次数, 节点
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> open;
+        open.push({heuristic(state.player), 0, 0});
+        while (!open.empty()) {
+            const auto [f, pushes, index] = open.top();
+            open.pop();
+            const auto current = nodes[index];
+            if (f - heuristic(keys[index].back()) != current.moves
+                || pushes != current.pushes) {
+                continue; // 已找到更短的路径
+            }
+            const std::u16string_view crates_view(keys[index].data(), crates);
+            const int player = keys[index].back();
+            if (crates_view == goal_key
+                && (goal_player == -1 || player == goal_player)) {
+                std::string result;
+                for (auto i = index; nodes[i].parent != -1;
+                     i = nodes[i].parent) {
+                    result += nodes[i].move;
+                }
+                std::reverse(result.begin(), result.end());
+                return result;
+            }
+
+            for (int direction = 0; direction < 4; direction++) {
+                const auto offset = offsets_[direction];
+                const auto next = player + offset;
+                if (tiles[next] & Tile::Wall) {
+                    continue;
+                }
+                auto child = keys[index];
+                const auto first = child.begin();
+                const auto last = first + static_cast<std::ptrdiff_t>(crates);
+                const auto crate = std::lower_bound(first, last, next);
+                const bool push = crate != last && *crate == next;
+                if (push) {
+                    const auto to = next + offset;
+                    if ((tiles[to] & Tile::Wall)
+                        || std::binary_search(first, last, to)) {
+                        continue;
+                    }
+                    *crate = static_cast<char16_t>(to);
+                    std::sort(first, last);
+                }
+                child.back() = static_cast<char16_t>(next);
+
+                const Node node {
+                    index,
+                    push ? static_cast<char>(
+                               std::toupper(moves_[direction])
+                           )
+                         : moves_[direction],
+                    current.moves + 1,
+                    current.pushes + push
+                };
+                const auto estimate = node.moves + heuristic(next);
+                if (estimate > bound) {
+                    continue;
+                }
+                const auto [it, inserted] = visited.try_emplace(
+                    child, static_cast<int>(nodes.size())
+                );
+                if (!inserted) {
+                    const auto& old = nodes[it->second];
+                    if (std::pair(old.moves, old.pushes)
+                        <= std::pair(node.moves, node.pushes)) {
+                        continue;
+                    }
+                    nodes[it->second] = node;
+                    open.push({estimate, node.pushes, it->second});
+                    continue;
+                }
+                if (nodes.size() >= node_limit_) {
+                    return std::nullopt;
+                }
+                nodes.push_back(node);
+                keys.push_back(std::move(child));
+                open.push({estimate, node.pushes, it->second});
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+	 * @brief 检查移动是否合法且到达终局.
+	 */
+    auto is_solution(const std::string& moves) const -> bool {
+        State state {tiles_, player_};
+        for (const auto move : moves) {
+            if (!state.step(offsets_[direction(move)], std::isupper(move))) {
+                return false;
+            }
+        }
+        return std::ranges::none_of(state.tiles, [](auto tile) {
+            return (tile & Tile::Crate) && !(tile & Tile::Target);
+        });
+    }
+
+    /**
+	 * @brief 获取移动 moves[start, end) 的移动次数和推动次数.
+	 */
+    static auto cost(const std::string& moves, size_t start, size_t end)
+        -> std::pair<int, int> {
+        const auto pushes = std::count_if(
+            moves.begin() + static_cast<std::ptrdiff_t>(start),
+            moves.begin() + static_cast<std::ptrdiff_t>(end),
+            [](auto move) { return std::isupper(move); }
+        );
+        return {static_cast<int>(end - start), static_cast<int>(pushes)};
+    }
+
+    /**
+	 * @brief 获取移动对应的方向, 顺序与 moves_ 相同, 无效时返回 -1.
+	 */
+    static auto direction(char move) noexcept -> int {
+        const auto it = std::ranges::find(moves_, std::tolower(move));
+        return it != moves_.end() ? static_cast<int>(it - moves_.begin())
+                                  : -1;
+    }
+
+    static constexpr std::array<char, 4> moves_ = {'u', 'd', 'l', 'r'};
+
+    int rotation_;
+    int stride_;
+    std::array<int, 4> offsets_;
+    std::vector<uint8_t> tiles_; // 含箱子的初始地图
+    int player_;
+
+    size_t node_limit_ = 200000;
+    int max_crates_ = 2;
+};
@@ -0,0 +1,312 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "arena.hpp"
+#include "bitboard.hpp"
+#include "board.hpp"
+
+/**
+ * @brief 箱子对的模式数据库.
+ *
+ * 记录在仅有两个箱子时, 将其推至两个不同目标点所需的精确推动次数, 考虑了角色的
+ * 可达性和箱子之间的阻挡. 数据通过从终局出发的逆向拉动广度优先搜索得到,
+ * 每个关卡只需计算一次.
+ *
+ * 搜索时将箱子划分为互不相交的箱子对, 各组代价之和仍是可采纳的启发值.
+ */
+class PatternDatabase {
+  public:
+    static constexpr uint8_t infinity = 255; // 箱子对无解
+    static constexpr int max_cells = 256; // 超过时不生成, 使数据可以放入 L2
+
+    PatternDatabase() = default;
+
+    /**
+	 * @brief 生成模式数据库.
+	 *
+	 * @param board   地图.
+	 * @param threads 线程数.
+	 */
+    explicit PatternDatabase(
+        const Board& board,
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency())
+    ) :
+        fingerprint_(board.fingerprint()) {
+        index(board);
+        if (size_ > max_cells) {
+            return;
+        }
+        costs_.assign(size_ * (size_ - 1) / 2, infinity);
+        build(board, std::max(threads, 1u));
+    }
+
+    /**
+	 * @brief 从序列化的数据加载.
+	 *
+	 * @param board 地图.
+	 * @param data  由 serialize 生成的数据.
+	 *
+	 * @return 数据与地图不匹配时返回 std::nullopt.
+	 */
+    static auto deserialize(const Board& board, std::span<const uint8_t> data)
+        -> std::optional<PatternDatabase> {
+        Header header;
+        if (data.size() < sizeof(header)) {
+            return std::nullopt;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        PatternDatabase database;
+        database.fingerprint_ = board.fingerprint();
+        database.index(board);
+        const auto size = static_cast<size_t>(database.size_);
+        const auto expected_size =
+            size > static_cast<size_t>(max_cells) ? 0 : size * (size - 1) / 2;
+        if (std::memcmp(header.magic, Header().magic, sizeof(header.magic))
+                != 0
+            || header.version != Header().version
+            || header.fingerprint != board.fingerprint()
+            || header.size != size
+            || data.size() != sizeof(header) + expected_size) {
+            return std::nullopt;
+        }
+        database.costs_.assign(data.begin() + sizeof(header), data.end());
+        return database;
+    }
+
+    /**
+	 * @brief 序列化, 用于缓存至数据库.
+	 */
+    auto serialize() const -> std::vector<uint8_t> {
+        Header header;
+        header.fingerprint = fingerprint_;
+        header.size = static_cast<uint32_t>(size_);
+        std::vector<uint8_t> data(sizeof(header));
+        std::memcpy(data.data(), &header, sizeof(header));
+        data.insert(data.end(), costs_.begin(), costs_.end());
+        return data;
+    }
+
+    auto empty() const noexcept -> bool {
+        return costs_.empty();
+    }
+
+    /**
+	 * @brief 获取将位于指定位置的两个箱子推至目标点所需的推动次数.
+	 *
+	 * @param a, b 不同的非死角位置.
+	 */
+    auto cost(int a, int b) const noexcept -> uint8_t {
+        return costs_[pair(indices_[a], indices_[b])];
+    }
+
+    /**
+	 * @brief 估计将所有箱子推至目标点所需的推动次数.
+	 *
+	 * 每个箱子先取其到最近目标点的距离, 再贪心地选取互不相交且代价增加最多的
+	 * 箱子对, 将其距离之和替换为箱子对的精确代价.
+	 *
+	 * @param board  地图.
+	 * @param crates 箱子位置, 均不能位于死角.
+	 *
+	 * @return 推动次数的下界, 存在无解的箱子对时返回 std::nullopt.
+	 */
+    template<class Range>
+    auto estimate(const Board& board, const Range& crates) const
+        -> std::optional<int> {
+        const auto count = static_cast<int>(std::size(crates));
+        int total = 0;
+        for (const int crate : crates) {
+            total += board.min_distance(crate);
+        }
+        if (empty()) {
+            return total;
+        }
+
+        std::pmr::vector<std::tuple<int, int, int>> gains(Arena::resource());
+        for (int i = 0; i < count; i++) {
+            const int a = crates[i];
+            for (int j = i + 1; j < count; j++) {
+                const int b = crates[j];
+                const auto pair_cost = cost(a, b);
+                if (pair_cost == infinity) {
+                    return std::nullopt;
+                }
+                const int gain =
+                    pair_cost - board.min_distance(a) - board.min_distance(b);
+                if (gain > 0) {
+                    gains.emplace_back(gain, i, j);
+                }
+            }
+        }
+        std::ranges::sort(gains, std::greater());
+
+        std::pmr::vector<bool> used(count, false, Arena::resource());
+        for (const auto& [gain, i, j] : gains) {
+            if (!used[i] && !used[j]) {
+                used[i] = used[j] = true;
+                total += gain;
+            }
+        }
+        return total;
+    }
+
+  private:
+    struct Header {
+        char magic[4] = {'S', 'K', 'P', 'D'};
+        uint32_t version = 1;
+        uint32_t fingerprint = 0;
+        uint32_t size = 0;
+    };
+
+    /**
+	 * @brief 搜索状态, 角色位置已规范化.
+	 */
+    struct State {
+        int a;
+        int b;
+        int player;
+    };
+
+    /**
+	 * @brief 为箱子可能位于的非死角位置编号.
+	 */
+    void index(const Board& board) {
+        indices_.assign(board.cells(), -1);
+        size_ = 0;
+        for (int i = 0; i < board.cells(); i++) {
+            if (board.is_floor(i) && !board.is_dead(i)) {
+                indices_[i] = size_++;
+            }
+        }
+    }
+
+    static auto pair(int i, int j) noexcept -> size_t {
+        if (i > j) {
+            std::swap(i, j);
+        }
+        return static_cast<size_t>(j) * (j - 1) / 2 + i;
+    }
+
+    /**
+	 * @brief 从所有终局出发, 逐层并行地进行逆向拉动广度优先搜索.
+	 */
+    void build(const Board& board, unsigned threads) {
+        std::vector<int> floors(board.cells(), -1);
+        int floor_count = 0;
+        for (int i = 0; i < board.cells(); i++) {
+            if (board.is_floor(i)) {
+                floors[i] = floor_count++;
+            }
+        }
+
+        // 状态的访问标记, 多个线程可能同时访问
+        const auto state_count = costs_.size() * floor_count;
+        std::vector<std::atomic<uint64_t>> visited((state_count + 63) / 64);
+        const auto visit = [&](const State& state) {
+            const auto i = pair(indices_[state.a], indices_[state.b])
+                             * floor_count
+                         + floors[state.player];
+            const auto bit = uint64_t(1) << (i % 64);
+            return !(visited[i / 64].fetch_or(bit) & bit);
+        };
+
+        // 终局: 两个箱子位于不同的目标点, 角色位于任意区域
+        std::vector<State> frontier;
+        const auto& targets = board.targets();
+        for (size_t i = 0; i < targets.size(); i++) {
+            for (size_t j = i + 1; j < targets.size(); j++) {
+                const auto crates =
+                    board.plane(std::array {targets[i], targets[j]});
+                for (const auto& area : board.regions(crates)) {
+                    const State state {
+                        targets[i],
+                        targets[j],
+                        board.normalize(area)
+                    };
+                    if (visit(state)) {
+                        frontier.push_back(state);
+                    }
+                }
+            }
+        }
+
+        const auto expand = [&](const State& state, std::vector<State>& next) {
+            const auto crates = board.plane(std::array {state.a, state.b});
+            const auto area = board.reachable(state.player, crates);
+            for (const auto& [crate, other] :
+                 {std::pair(state.a, state.b), std::pair(state.b, state.a)}) {
+                for (int direction = 0; direction < 4; direction++) {
+                    // 角色位于箱子旁, 拉动箱子后退一格
+                    const auto offset = board.offset(direction);
+                    const auto to = crate + offset, player = to + offset;
+                    if (!board.contains(area, to) || !board.is_floor(player)
+                        || player == other) {
+                        continue;
+                    }
+                    const State pulled {
+                        to,
+                        other,
+                        board.normalize(board.reachable(
+                            player,
+                            board.plane(std::array {to, other})
+                        ))
+                    };
+                    if (visit(pulled)) {
+                        next.push_back(pulled);
+                    }
+                }
+            }
+        };
+
+        for (int depth = 0; !frontier.empty(); depth++) {
+            for (const auto& state : frontier) {
+                auto& cost = costs_[pair(indices_[state.a], indices_[state.b])];
+                cost = std::min<int>(cost, std::min(depth, infinity - 1));
+            }
+
+            std::vector<std::vector<State>> next(threads);
+            if (threads == 1 || frontier.size() < 64) {
+                for (const auto& state : frontier) {
+                    expand(state, next[0]);
+                }
+            } else {
+                std::vector<std::jthread> workers;
+                const auto chunk = (frontier.size() + threads - 1) / threads;
+                for (unsigned t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t] {
+                        const auto first = std::min(t * chunk, frontier.size());
+                        const auto last =
+                            std::min(first + chunk, frontier.size());
+                        for (auto i = first; i < last; i++) {
+                            expand(frontier[i], next[t]);
+                        }
+                    });
+                }
+            }
+
+            frontier.clear();
+            for (const auto& states : next) {
+                frontier.insert(frontier.end(), states.begin(), states.end());
+            }
+        }
+    }
+
+    std::vector<int> indices_;
+    int size_ = 0;
+    std::vector<uint8_t> costs_;
+    uint32_t fingerprint_ = 0;
+};
@@ -0,0 +1,248 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <string>
+
+#include "animation.hpp"
+#include "level.hpp"
+
+/**
+ * @brief 移动调度器.
+ *
+ * 移动逻辑立即作用于关卡, 调度器仅负责按帧推进移动队列并计算动画进度,
+ * 不会阻塞调用线程.
+ */
+class Scheduler {
+  public:
+    /**
+	 * @brief 添加一组移动, 该组移动在关卡中记录为一条移动记录.
+	 *
+	 * @param movement LURD 格式移动记录.
+	 */
+    void play(const std::string& movement) {
+        if (movement.empty()) {
+            return;
+        }
+        if (!replay_.empty()) {
+            // 用户的移动中断回放, 丢弃回放中剩余的移动
+            pending_.clear();
+            replay_.clear();
+            paused_ = false;
+        }
+        for (size_t i = 0; i < movement.size(); i++) {
+            pending_.push_back({movement[i], i != 0});
+        }
+    }
+
+    /**
+	 * @brief 从初始状态开始回放答案.
+	 *
+	 * @param level    关卡.
+	 * @param solution LURD 格式答案.
+	 */
+    void replay(Level& level, const std::string& solution) {
+        pending_.clear();
+        animation_ = {};
+        level.reset();
+        replay_ = solution;
+        cursor_ = 0;
+        paused_ = false;
+        for (size_t i = 0; i < solution.size(); i++) {
+            pending_.push_back({solution[i], i != 0});
+        }
+    }
+
+    /**
+	 * @brief 推进移动队列, 应每帧调用一次.
+	 *
+	 * @param level   关卡.
+	 * @param elapsed 距上一帧经过的时间.
+	 */
+    void update(Level& level, sf::Time elapsed) {
+        if (paused_) {
+            return;
+        }
+        if (interval_ == sf::Time::Zero) {
+            flush(level);
+            return;
+        }
+
+        time_ += elapsed * speed_;
+        while (!pending_.empty() && time_ >= interval_) {
+            step(level);
+            time_ -= interval_;
+        }
+        if (pending_.empty()) {
+            time_ = std::min(time_, interval_);
+        }
+        animation_.progress = std::min(time_ / interval_, 1.f);
+    }
+
+    /**
+	 * @brief 跳过动画, 立即完成队列中的全部移动.
+	 *
+	 * @param level 关卡.
+	 */
+    void skip(Level& level) {
+        flush(level);
+    }
+
+    /**
+	 * @brief 在回放中跳转.
+	 *
+	 * @param level  关卡.
+	 * @param offset 相对当前位置的移动步数, 负数表示后退.
+	 */
+    void seek(Level& level, int offset) {
+        if (replay_.empty()) {
+            return;
+        }
+        const auto target = static_cast<size_t>(std::clamp(
+            static_cast<int>(cursor_) + offset,
+            0,
+            static_cast<int>(replay_.size())
+        ));
+        if (target < cursor_) {
+            level.seek(target);
+        } else {
+            level.play(
+                replay_.substr(cursor_, target - cursor_),
+                cursor_ != 0
+            );
+        }
+        cursor_ = target;
+
+        pending_.clear();
+        for (size_t i = cursor_; i < replay_.size(); i++) {
+            pending_.push_back({replay_[i], i != 0});
+        }
+        animation_ = {};
+    }
+
+    /**
+	 * @brief 取消队列中尚未完成的移动.
+	 */
+    void stop() {
+        pending_.clear();
+        replay_.clear();
+        animation_ = {};
+        paused_ = false;
+    }
+
+    void pause() {
+        paused_ = true;
+    }
+
+    void resume() {
+        paused_ = false;
+    }
+
+    auto paused() const -> bool {
+        return paused_;
+    }
+
+    /**
+	 * @brief 是否正在回放答案.
+	 */
+    auto replaying() const -> bool {
+        return !replay_.empty() && !pending_.empty();
+    }
+
+    /**
+	 * @brief 是否已完成全部移动和动画.
+	 */
+    auto idle() const -> bool {
+        return pending_.empty() && !animation_.active();
+    }
+
+    auto animation() const -> Animation {
+        return animation_;
+    }
+
+    void set_interval(std::chrono::milliseconds interval) {
+        interval_ = sf::milliseconds(static_cast<int32_t>(interval.count()));
+    }
+
+    auto interval() const -> std::chrono::milliseconds {
+        return std::chrono::milliseconds(interval_.asMilliseconds());
+    }
+
+    /**
+	 * @brief 设置播放速度倍率.
+	 *
+	 * @param speed 播放速度倍率.
+	 */
+    void set_speed(float speed) {
+        speed_ = std::clamp(speed, 1.f / 16, 256.f);
+    }
+
+    auto speed() const -> float {
+        return speed_;
+    }
+
+  private:
+    struct Move {
+        char move;
+        bool merge; // 是否合并到上一条移动记录
+    };
+
+    /**
+	 * @brief 执行队列中的下一步移动, 并开始对应的动画.
+	 */
+    void step(Level& level) {
+        const auto [move, merge] = pending_.front();
+        pending_.pop_front();
+
+        const auto player_pos = level.player_position();
+        level.play(std::string(1, move), merge);
+        if (!replay_.empty()) {
+            cursor_++;
+        }
+
+        animation_.direction = level.player_position() - player_pos;
+        animation_.push = animation_.direction != sf::Vector2i(0, 0)
+                       && std::isupper(level.history().back());
+        animation_.progress = 0.f;
+    }
+
+    /**
+	 * @brief 立即执行队列中的全部移动.
+	 */
+    void flush(Level& level) {
+        std::string movement;
+        bool merge = false;
+        for (const auto& move : pending_) {
+            if (!move.merge && !movement.empty()) {
+                level.play(movement, merge);
+                movement.clear();
+            }
+            if (movement.empty()) {
+                merge = move.merge;
+            }
+            movement.push_back(move.move);
+        }
+        level.play(movement, merge);
+        cursor_ = replay_.size();
+        pending_.clear();
+        animation_ = {};
+        paused_ = false;
+    }
+
+    std::deque<Move> pending_;
+    Animation animation_;
+
+    std::string replay_;
+    size_t cursor_ = 0;
+
+    sf::Time interval_ = sf::milliseconds(100);
+    sf::Time time_;
+    float speed_ = 1.f;
+    bool paused_ = false;
+};
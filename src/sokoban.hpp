@@ -10,11 +10,17 @@
 #include <iostream>
 #include <optional>
 #include <thread>
+#include <utility>
 
 #include "SFML/System/Vector2.hpp"
 #include "database.hpp"
+#include "hint_engine.hpp"
+#include "journal.hpp"
 #include "level.hpp"
+#include "level_cache.hpp"
+#include "level_prefetcher.hpp"
 #include "material.hpp"
+#include "scheduler.hpp"
 
 class Sokoban {
   public:
@@ -22,7 +28,18 @@ class Sokoban {
         level_(""),
         passed_sound_(passed_buffer_),
         material_("assets/img/default.png"),
-        database_("database.db") {}
+        database_("database.db"),
+        deadlock_database_("deadlock.db"),
+        journal_("session.journal"),
+        level_prefetcher_("database.db"),
+        hint_engine_("database.db") {
+        Level::set_deadlock_database(&deadlock_database_);
+    }
+
+    ~Sokoban() {
+        hint_engine_.stop();
+        Level::set_deadlock_database(nullptr);
+    }
 
     void run(int argc, char* argv[]) {
         load_sounds();
@@ -49,7 +66,11 @@ class Sokoban {
 | BackSpace          | Single step undo                  |
 | R                  | Rotate map clockwise              |
 | -/=                | Switch to the previous/next level |
-| P                  | Replay solution                   |
+| P                  | Replay solution / Pause replay    |
+| [/]                | Seek replay backward/forward      |
+| ,/.                | Slow down/Speed up replay         |
+| Enter              | Skip animation                    |
+| Ctrl + H           | Show/Hide hint                    |
 | Ctrl + I           | Switch instant move               |
 | Ctrl + V           | Import level from clipboard       |
 
@@ -102,19 +123,22 @@ class Sokoban {
 
         load_latest_session();
 
-        input_thread_ = std::jthread([&](const std::stop_token& token) {
-            while (!token.stop_requested()) {
-                handle_input();
-            }
-        });
-
+        // 输入与关卡的所有读写均在主线程中按帧处理
+        sf::Clock frame_clock;
         while (window_.isOpen()) {
             handle_window_event();
+            handle_input();
 
+            scheduler_.update(level_, frame_clock.restart());
+            if (level_.crates_on_target() != crates_on_target_) {
+                update_title();
+            }
+            update_hint();
+            journal_.record(level_.history());
             render();
 
-            if (!level_.movements().empty()
-                && std::isupper(level_.movements().back().back())
+            if (scheduler_.idle() && !level_.history().empty()
+                && std::isupper(level_.history().back())
                 && level_.passed()) {
                 render();
 
@@ -127,20 +151,66 @@ class Sokoban {
                     database_.get_level_id(level_).value(),
                     ""
                 );
+                journal_.clear();
 
+                scheduler_.stop();
                 load_next_unsolved_level();
             }
         }
-        database_.update_session_movement(level_);
+        save_session();
     }
 
   private:
     void render() {
-        level_.render(window_, material_);
+        level_.render(window_, material_, scheduler_.animation());
         window_.display();
         window_.clear(sf::Color(115, 115, 115));
     }
 
+    /**
+	 * @brief 更新窗口标题, 显示关卡标题和已归位的箱子数量.
+	 */
+    void update_title() {
+        crates_on_target_ = level_.crates_on_target();
+        std::string title = "Sokoban";
+        if (level_.metadata().contains("title")) {
+            title += " - " + level_.metadata().at("title");
+        }
+        title += " (" + std::to_string(crates_on_target_) + '/'
+               + std::to_string(level_.target_positions().size()) + ')';
+        window_.setTitle(title);
+    }
+
+    /**
+	 * @brief 将关卡的当前状态提交给提示引擎, 并显示其给出的下一次推动.
+	 *
+	 * 提示的标记只在此处修改, 关闭提示时也由此清除.
+	 */
+    void update_hint() {
+        if (!hint_enabled_) {
+            if (shown_hint_.has_value()) {
+                level_.clear(Tile::CrateMovable);
+                shown_hint_.reset();
+            }
+            return;
+        }
+        if (selected_crate_ != sf::Vector2i(-1, -1) || !scheduler_.idle()) {
+            return;
+        }
+        hint_engine_.update(level_);
+        const auto hint = hint_engine_.hint();
+        if (hint == shown_hint_
+            && (!hint.has_value()
+                || level_.at(hint->target) & Tile::CrateMovable)) {
+            return;
+        }
+        level_.clear(Tile::CrateMovable);
+        shown_hint_ = hint;
+        if (hint.has_value()) {
+            level_.mark(hint->target, Tile::CrateMovable);
+        }
+    }
+
     void load_sounds() {
         if (!passed_buffer_.loadFromFile("assets/audio/success.wav")) {
             throw std::runtime_error("failed to load audio");
@@ -213,69 +283,116 @@ class Sokoban {
 
     void load_next_level() {
         const auto id = database_.get_level_id(level_).value();
-        auto result = database_.get_level_by_id(id + 1);
+        auto result = load_level(id + 1);
         if (!result.has_value()) {
             return;
         }
-        level_ = result.value();
+        save_session();
+        level_ = std::move(result.value());
 
         print_info();
-        if (level_.metadata().contains("title")) {
-            window_.setTitle("Sokoban - " + level_.metadata().at("title"));
-        }
+        update_title();
 
-        database_.upsert_level_session(level_);
-        level_.play(database_.get_level_session_movements(level_));
+        open_session();
     }
 
     void load_prev_level() {
         const auto id = database_.get_level_id(level_).value();
-        const auto result = database_.get_level_by_id(id - 1);
+        auto result = load_level(id - 1);
         if (!result.has_value())
             return;
-        level_ = result.value();
+        save_session();
+        level_ = std::move(result.value());
 
         print_info();
-        if (level_.metadata().contains("title")) {
-            window_.setTitle("Sokoban - " + level_.metadata().at("title"));
-        }
+        update_title();
 
-        database_.upsert_level_session(level_);
-        level_.play(database_.get_level_session_movements(level_));
+        open_session();
     }
 
     void load_next_unsolved_level() {
-        auto id = database_.get_level_id(level_).value();
-        while (true) {
-            if (auto level = database_.get_level_by_id(++id); level.has_value()
-                && !level.value().metadata().contains("answer")) {
-                level_ = level.value();
-                break;
+        auto level = level_prefetcher_.take();
+        if (!level.has_value()) {
+            const auto id = database_.get_next_unsolved_level_id(
+                database_.get_level_id(level_).value()
+            );
+            if (id.has_value()) {
+                level = load_level(id.value());
             }
         }
+        if (!level.has_value()) {
+            // 之后的关卡均已有答案, 重新开始当前关卡
+            level_.reset();
+            open_session();
+            return;
+        }
+        level_ = std::move(level.value());
 
         print_info();
-        if (level_.metadata().contains("title")) {
-            window_.setTitle("Sokoban - " + level_.metadata().at("title"));
-        }
+        update_title();
 
-        database_.upsert_level_session(level_);
-        level_.play(database_.get_level_session_movements(level_));
+        open_session();
+    }
+
+    /**
+	 * @brief 通过 ID 加载关卡, 优先使用缓存中已解析的关卡.
+	 *
+	 * @param id 关卡 ID.
+	 */
+    auto load_level(int id) -> std::optional<Level> {
+        const auto fingerprint = database_.get_level_fingerprint(id);
+        if (!fingerprint.has_value()) {
+            return std::nullopt;
+        }
+        if (const auto level = level_cache_.get(id, fingerprint.value())) {
+            return *level;
+        }
+        auto level = database_.get_level_by_id(id);
+        if (level.has_value()) {
+            level_cache_.put(id, fingerprint.value(), level.value());
+        }
+        return level;
     }
 
     void load_latest_session() {
+        // 将上次运行时日志中的移动合并至数据库
+        if (const auto session = journal_.replay(); session.has_value()) {
+            database_.update_session_movement(
+                session->level_id,
+                session->movement
+            );
+            journal_.clear();
+        }
+
         level_ =
-            database_
-                .get_level_by_id(database_.get_latest_level_id().value_or(1))
-                .value();
+            load_level(database_.get_latest_level_id().value_or(1)).value();
 
         print_info();
-        if (level_.metadata().contains("title")) {
-            window_.setTitle("Sokoban - " + level_.metadata().at("title"));
-        }
+        update_title();
+
+        open_session();
+    }
 
+    /**
+	 * @brief 打开当前关卡的会话, 恢复之前的移动并开始记录日志.
+	 *
+	 * 会话和日志只在主线程中读写, 与关卡的移动记录保持一致.
+	 */
+    void open_session() {
         database_.upsert_level_session(level_);
         level_.play(database_.get_level_session_movements(level_));
+        const auto id = database_.get_level_id(level_).value();
+        journal_.begin(id, level_.history());
+        // 在后台预先加载之后第一个没有答案的关卡, 通过本关后直接切换
+        level_prefetcher_.request(id);
+    }
+
+    /**
+	 * @brief 将当前关卡的会话移动写入数据库, 并清空日志.
+	 */
+    void save_session() {
+        database_.update_session_movement(level_);
+        journal_.clear();
     }
 
     void create_window() {
@@ -295,8 +412,6 @@ class Sokoban {
     void handle_window_event() {
         while (const auto event = window_.pollEvent()) {
             if (event->is<sf::Event::Closed>()) {
-                input_thread_.request_stop();
-                input_thread_.join();
                 window_.close();
             } else if (const auto resized_event =
                            event->getIf<sf::Event::Resized>()) {
@@ -340,6 +455,9 @@ class Sokoban {
             return;
         }
 
+        // 鼠标操作基于关卡的最新状态, 需先完成队列中的移动
+        scheduler_.skip(level_);
+
         if (selected_crate_ != sf::Vector2i(-1, -1)) {
             if (level_.at(mouse_pos) & Tile::CrateMovable
                 && selected_crate_ != mouse_pos) {
@@ -355,6 +473,9 @@ class Sokoban {
                 }
                 std::reverse(path.begin(), path.end());
 
+                // 在关卡副本上生成完整的移动记录, 再交由调度器播放
+                Level level(level_);
+                std::string movement;
                 auto crate_pos = selected_crate_;
                 for (const auto& pos : path) {
                     sf::Vector2i push_dir;
@@ -362,10 +483,20 @@ class Sokoban {
                     push_dir.y = std::clamp(pos.y - crate_pos.y, -1, 1);
                     const auto start = crate_pos - push_dir;
                     const auto end = pos - push_dir;
-                    move_to(start, Tile::Wall | Tile::Crate);
-                    move_to(end, Tile::Wall);
+                    for (const auto& [target, border_tiles] :
+                         {std::pair<sf::Vector2i, uint8_t>(
+                              start,
+                              Tile::Wall | Tile::Crate
+                          ),
+                          std::pair<sf::Vector2i, uint8_t>(end, Tile::Wall)}) {
+                        const auto steps =
+                            movement_to(level, target, border_tiles);
+                        level.play(steps);
+                        movement += steps;
+                    }
                     crate_pos = pos;
                 }
+                scheduler_.play(movement);
 
                 std::cout << "Move crate: "
                           << clock.getElapsedTime().asMicroseconds()
@@ -383,8 +514,9 @@ class Sokoban {
             }
             return;
         } else if (level_.at(mouse_pos) & Tile::Crate) {
-            // 选中鼠标处的箱子
+            // 选中鼠标处的箱子, 并清除提示
             sf::Clock clock;
+            level_.clear(Tile::CrateMovable);
             came_from_ = level_.calc_crate_movable(mouse_pos);
             std::cout << "Calc crate movable: "
                       << clock.getElapsedTime().asMicroseconds()
@@ -396,15 +528,27 @@ class Sokoban {
         if (level_.at(mouse_pos) & Tile::Floor
             && !(level_.at(mouse_pos) & Tile::Crate)) {
             // 移动角色到点击位置
-            move_to(mouse_pos, Tile::Wall | Tile::Crate);
+            scheduler_.play(
+                movement_to(level_, mouse_pos, Tile::Wall | Tile::Crate)
+            );
         }
     }
 
-    void move_to(const sf::Vector2i& pos, uint8_t border_tiles) {
+    /**
+	 * @brief 计算角色移动到指定位置的 LURD 格式移动记录.
+	 *
+	 * @param level        关卡.
+	 * @param pos          目标位置.
+	 * @param border_tiles 障碍物.
+	 */
+    static auto movement_to(
+        const Level& level,
+        const sf::Vector2i& pos,
+        uint8_t border_tiles
+    ) -> std::string {
         // 反着写是因为起始点可以为箱子, 但结束点不能
-        auto path =
-            level_.find_path(pos, level_.player_position(), border_tiles);
-        auto current_pos = level_.player_position();
+        auto path = level.find_path(pos, level.player_position(), border_tiles);
+        auto current_pos = level.player_position();
         std::string movement;
         while (!path.empty()) {
             const auto direction = path.back() - current_pos;
@@ -420,72 +564,100 @@ class Sokoban {
             }
             current_pos += direction;
         }
-        level_.play(movement, move_interval_);
+        return movement;
     }
 
     void handle_keyboard_input() {
         if (keyboard_input_clock_.getElapsedTime() < sf::seconds(0.25f)) {
             return;
         }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W)
+        // H 用于移动角色, 需先检查 Ctrl + H
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::LControl)
+            && sf::Keyboard::isKeyPressed(sf::Keyboard::Key::H)) {
+            hint_enabled_ = !hint_enabled_;
+            keyboard_input_clock_.restart();
+        } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W)
             || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up)
             || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::K)) {
-            level_.play("u");
+            scheduler_.play("u");
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S)
                    || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down)
                    || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::J)) {
-            level_.play("d");
+            scheduler_.play("d");
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A)
                    || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left)
                    || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::H)) {
-            level_.play("l");
+            scheduler_.play("l");
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D)
                    || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right)
                    || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::L)) {
-            level_.play("r");
+            scheduler_.play("r");
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Backspace)) {
+            scheduler_.stop();
             level_.undo();
             selected_crate_ = {-1, -1};
             level_.clear(Tile::PlayerMovable | Tile::CrateMovable);
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Escape)) {
+            scheduler_.stop();
             level_.reset();
             selected_crate_ = {-1, -1};
             level_.clear(Tile::PlayerMovable | Tile::CrateMovable);
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::R)) {
+            scheduler_.skip(level_);
             level_.rotate();
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Hyphen)) {
+            scheduler_.stop();
             load_prev_level();
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Equal)) {
+            scheduler_.stop();
             load_next_level();
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::P)) {
-            if (!level_.metadata().contains("solution"))
-                return;
-            if (!level_.movements().empty()) {
-                level_.reset();
-                std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (scheduler_.replaying()) {
+                if (scheduler_.paused())
+                    scheduler_.resume();
+                else
+                    scheduler_.pause();
+            } else if (level_.metadata().contains("solution")) {
+                scheduler_.replay(level_, level_.metadata().at("solution"));
             }
-            level_.play(level_.metadata().at("solution"), move_interval_);
+            keyboard_input_clock_.restart();
+        } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::LBracket)) {
+            scheduler_.seek(level_, -10);
+            keyboard_input_clock_.restart();
+        } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::RBracket)) {
+            scheduler_.seek(level_, 10);
+            keyboard_input_clock_.restart();
+        } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Comma)) {
+            scheduler_.set_speed(scheduler_.speed() / 2);
+            keyboard_input_clock_.restart();
+        } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Period)) {
+            scheduler_.set_speed(scheduler_.speed() * 2);
+            keyboard_input_clock_.restart();
+        } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Enter)) {
+            scheduler_.skip(level_);
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::LControl)
                    && sf::Keyboard::isKeyPressed(sf::Keyboard::Key::V)) {
+            scheduler_.stop();
+            save_session();
             level_ = import_level_from_clipboard().value();
-            database_.upsert_level_session(level_);
+            open_session();
             keyboard_input_clock_.restart();
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::LControl)
                    && sf::Keyboard::isKeyPressed(sf::Keyboard::Key::I)) {
-            if (move_interval_ != std::chrono::milliseconds(0))
-                move_interval_ = std::chrono::milliseconds(0);
+            if (scheduler_.interval() != std::chrono::milliseconds(0))
+                scheduler_.set_interval(std::chrono::milliseconds(0));
             else
-                move_interval_ = std::chrono::milliseconds(150);
+                scheduler_.set_interval(std::chrono::milliseconds(150));
             keyboard_input_clock_.restart();
         }
     }
@@ -498,16 +670,9 @@ class Sokoban {
     }
 
     void print_result() {
-        const auto movement = level_.movement();
-        std::cout << "Moves: " << movement.size() << '\n';
-        std::cout << "Pushs: "
-                  << std::count_if(
-                         movement.begin(),
-                         movement.end(),
-                         [](auto c) { return std::isupper(c); }
-                     )
-                  << '\n';
-        std::cout << "LURD : " << movement << '\n' << '\n';
+        std::cout << "Moves: " << level_.history().size() << '\n';
+        std::cout << "Pushs: " << level_.history().pushes() << '\n';
+        std::cout << "LURD : " << level_.movement() << '\n' << '\n';
     }
 
     Level level_;
@@ -520,12 +685,21 @@ class Sokoban {
     sf::Music background_music_;
 
     sf::Clock keyboard_input_clock_, mouse_select_clock_;
-    std::jthread input_thread_;
 
-    std::chrono::milliseconds move_interval_ = std::chrono::milliseconds(100);
+    Scheduler scheduler_;
+
+    size_t crates_on_target_ = 0;
 
     sf::Vector2i selected_crate_ = {-1, -1};
     std::unordered_map<sf::Vector2i, sf::Vector2i> came_from_;
 
     Database database_;
+    DeadlockDatabase deadlock_database_;
+    Journal journal_;
+    LevelCache level_cache_;
+    LevelPrefetcher level_prefetcher_;
+
+    HintEngine hint_engine_;
+    bool hint_enabled_ = false;
+    std::optional<HintEngine::Hint> shown_hint_;
 };
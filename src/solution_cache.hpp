@@ -0,0 +1,21 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 解缓存中的条目.
+ *
+ * 以局面的规范哈希值为键, 记录从该局面出发已知的推动序列. 哈希值在未旋转的
+ * 地图上计算, 角色位置已规范化, 因此与关卡的方向和角色在可到达区域中的具体
+ * 位置无关.
+ */
+struct CachedSolution {
+    uint64_t key;              // 局面的规范哈希值
+    int pushes;                // 推动次数
+    int bound;                 // 推动次数的下界, 与 pushes 相等时解最优
+    std::vector<uint8_t> data; // 序列化的推动序列
+};
@@ -0,0 +1,1496 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <queue>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "bitboard.hpp"
+#include "board.hpp"
+#include "deadlock.hpp"
+#include "deadlock_database.hpp"
+#include "external_sort.hpp"
+#include "level.hpp"
+#include "pattern_database.hpp"
+#include "solution_cache.hpp"
+#include "tile.hpp"
+#include "transposition_table.hpp"
+
+/**
+ * @brief 推箱子求解器.
+ *
+ * 以推动为单位进行 A* 搜索, 找到推动次数最少的解. 也可以从终局出发拉动箱子
+ * 进行逆向搜索, 或同时进行双向搜索. 启发函数取箱子与目标点的
+ * 最小权匹配和模式数据库估计值中的较大者. 搜索在未旋转的地图上进行, 得到的解
+ * 会被旋转至关卡当前的方向, 因此可以直接用于 Level::play.
+ *
+ * 正向搜索使用宏移动减少分支: 隧道中的箱子会被连续推动, 到达目标房间入口的
+ * 箱子会被直接推至房间中下一个需要填充的目标点. 目标房间的填充顺序是固定的,
+ * 因此存在目标房间时解可能不是推动次数最少的.
+ *
+ * 状态数超出内存容量时可以使用外存搜索, 以推动次数为层进行广度优先搜索,
+ * 各层的状态存放于临时文件中, 不使用宏移动, 因此解总是推动次数最少的.
+ *
+ * 搜索受节点数, 时间和内存预算限制, 可以通过 std::stop_token 取消. 启发函数
+ * 的权重大于 1 时正向搜索会先快速找到一个解, 之后在预算内继续寻找推动次数
+ * 更少的解, 直至搜索空间耗尽. 搜索未使用目标房间宏移动时, 此时的解是推动
+ * 次数最少的, 否则只是宏移动所能得到的最优解.
+ *
+ * 正向搜索得到的解会被记录在置换表中. 通过 reroot 将起点移至同一地图的其他
+ * 状态后, 若新状态位于已知解的路径上, 则无需搜索即可得到解. 设置解缓存后,
+ * 解还会被持久化, 供之后的求解使用.
+ */
+class Solver {
+  public:
+    /**
+	 * @brief 搜索模式.
+	 */
+    enum class Mode {
+        Forward,       // 从初始状态推动箱子
+        Backward,      // 从终局拉动箱子
+        Bidirectional, // 同时进行正向和逆向搜索, 直至相遇
+        External,      // 在外存中逐层进行广度优先搜索
+    };
+
+    /**
+	 * @brief 搜索统计.
+	 */
+    struct Statistics {
+        size_t expanded = 0;  // 展开的节点数
+        size_t generated = 0; // 生成的节点数
+        size_t corrals = 0;   // 使用 PI 围栏剪枝的节点数
+        size_t pruned = 0;    // 因 PI 围栏剪枝而未生成的推动数
+        bool stopped = false; // 是否因超出预算或被取消而提前停止
+        bool macros = false;  // 是否使用了目标房间宏移动, 此时解可能不是最优的
+    };
+
+    /**
+	 * @brief 搜索进度.
+	 */
+    struct Progress {
+        size_t expanded;                       // 展开的节点数
+        size_t frontier;                       // 待展开的节点数
+        double nodes_per_second;               // 平均每秒展开的节点数
+        int lower_bound;                       // 推动次数的下界
+        std::optional<int> best;               // 当前最优解的推动次数
+        std::chrono::duration<double> elapsed; // 已用时间
+    };
+
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param level 关卡, 从其当前状态开始求解.
+	 */
+    explicit Solver(const Level& level) :
+        board_(unrotated(level)), rotation_(level.rotation()) {
+        // 箱子位置, 角色位置, 搜索方向和已知解的 Zobrist 键
+        zobrist_.resize(board_.cells() * 2 + 3);
+        uint64_t seed = board_.fingerprint();
+        for (auto& key : zobrist_) {
+            key = splitmix64(seed);
+        }
+        set_initial_state(unrotated(level));
+    }
+
+    /**
+	 * @brief 将求解的起点移至关卡的当前状态.
+	 *
+	 * 置换表, 模式数据库和设置均被保留. 之前求得的解经过的状态会被记录在置换表
+	 * 中, 新的起点位于这些状态上时无需搜索即可得到解.
+	 *
+	 * @param level 关卡, 地图须与构造时的关卡相同, 方向可以不同.
+	 *
+	 * @return 地图不同时返回 false, 求解器保持不变.
+	 */
+    auto reroot(const Level& level) -> bool {
+        const auto base = unrotated(level);
+        const auto& map = base.map();
+        if (base.size().x + 2 != board_.stride()
+            || static_cast<int>(map.size()) != board_.cells()) {
+            return false;
+        }
+        for (int i = 0; i < board_.cells(); i++) {
+            if ((map[i] & (Tile::Floor | Tile::Wall | Tile::Target))
+                != board_.tile(i)) {
+                return false;
+            }
+        }
+        rotation_ = level.rotation();
+        set_initial_state(base);
+        return true;
+    }
+
+    /**
+	 * @brief 设置模式数据库.
+	 *
+	 * @param database 基于 board() 生成的模式数据库.
+	 */
+    void set_pattern_database(PatternDatabase database) {
+        pattern_database_ = std::move(database);
+    }
+
+    /**
+	 * @brief 设置内存预算.
+	 *
+	 * 节点, 待展开队列和置换表占用的内存超出预算时停止搜索. 置换表从较小的
+	 * 容量开始, 在预算内按需扩容. 无法扩容时会淘汰部分状态, 重复到达这些
+	 * 状态时节点会被重复展开, 不影响解的正确性.
+	 * 外存搜索时为排序和读写缓冲区占用的内存上限.
+	 *
+	 * @param bytes 字节数.
+	 */
+    void set_memory_budget(size_t bytes) {
+        memory_budget_ = bytes;
+        table_.reset();
+    }
+
+    /**
+	 * @brief 设置外存搜索存放临时文件的目录, 默认为系统的临时目录.
+	 */
+    void set_temporary_directory(std::filesystem::path path) {
+        temporary_directory_ = std::move(path);
+    }
+
+    /**
+	 * @brief 设置展开节点数的上限, 0 表示不限制.
+	 */
+    void set_node_limit(size_t nodes) noexcept {
+        node_limit_ = nodes;
+    }
+
+    /**
+	 * @brief 设置搜索时间的上限, 0 表示不限制.
+	 */
+    void set_time_limit(std::chrono::steady_clock::duration time) noexcept {
+        time_limit_ = time;
+    }
+
+    /**
+	 * @brief 设置启发函数的权重.
+	 *
+	 * 权重大于 1 时为 anytime 加权 A* 搜索: 先快速找到一个解, 之后剪去无法
+	 * 得到更优解的节点并继续搜索, 直至搜索空间耗尽或超出预算. 仅用于正向
+	 * 搜索.
+	 *
+	 * @param weight 权重, 默认为 1.
+	 */
+    void set_weight(double weight) noexcept {
+        weight_ = std::max(weight, 1.0);
+    }
+
+    /**
+	 * @brief 设置进度回调函数, 在求解线程中按间隔调用.
+	 *
+	 * @param callback 回调函数.
+	 * @param interval 调用间隔.
+	 */
+    void set_progress_callback(
+        std::function<void(const Progress&)> callback,
+        std::chrono::steady_clock::duration interval =
+            std::chrono::milliseconds(500)
+    ) {
+        progress_callback_ = std::move(callback);
+        progress_interval_ = interval;
+    }
+
+    /**
+	 * @brief 设置找到更优的解时调用的回调函数, 参数为 LURD 格式的解.
+	 */
+    void
+    set_solution_callback(std::function<void(const std::string&)> callback) {
+        solution_callback_ = std::move(callback);
+    }
+
+    /**
+	 * @brief 设置解缓存.
+	 *
+	 * 求解前先查询初始局面, 缓存的解已被证明最优时直接返回, 否则在正向搜索中
+	 * 作为推动次数的上界. 求解后将解经过的各局面及其剩余的推动写入缓存.
+	 *
+	 * @param load  查询函数, 参数为局面的哈希值, 未命中时返回 std::nullopt.
+	 * @param store 写入函数, 参数为同一个解经过的各局面的条目.
+	 */
+    void set_solution_cache(
+        std::function<std::optional<CachedSolution>(uint64_t)> load,
+        std::function<void(const std::vector<CachedSolution>&)> store
+    ) {
+        cache_load_ = std::move(load);
+        cache_store_ = std::move(store);
+    }
+
+    /**
+	 * @brief 求解.
+	 *
+	 * @param mode 搜索模式. 外存搜索保证推动次数最少; 正向搜索仅在未使用
+	 *             目标房间宏移动时保证推动次数最少.
+	 * @param stop 停止请求, 请求后搜索会尽快停止.
+	 *
+	 * @return std::optional<std::string> LURD 格式的解, 无解时返回
+	 *         std::nullopt. 提前停止时返回已找到的最优解, 并设置
+	 *         Statistics::stopped.
+	 */
+    auto solve(Mode mode = Mode::Forward, std::stop_token stop = {})
+        -> std::optional<std::string> {
+        statistics_ = {};
+        stop_ = std::move(stop);
+        start_ = std::chrono::steady_clock::now();
+        last_report_ = start_;
+        bound_ = infinity;
+        if (initial_crates_.size() != board_.targets().size()) {
+            return std::nullopt;
+        }
+        for (const auto crate : initial_crates_) {
+            if (board_.is_dead(crate) && !board_.is_target(crate)) {
+                return std::nullopt;
+            }
+        }
+        auto cached = load_cached();
+        if (cached.has_value()
+            && cached->bound >= static_cast<int>(cached->pushes.size())) {
+            return movement(cached->pushes);
+        }
+        if (mode == Mode::External) {
+            return solve_external();
+        }
+
+        searches_ = {};
+        meeting_.reset();
+        active_weight_ = mode == Mode::Forward ? weight_ : 1.0;
+        // 置换表在多次求解间复用, 旧条目会被优先淘汰, 且使用前会校验状态
+        if (!table_.has_value()) {
+            table_.emplace(
+                std::min(memory_budget_, size_t(1) << 20),
+                TranspositionTable::Replacement::Age
+            );
+        }
+        table_->new_generation();
+
+        if (const auto known = recall()) {
+            return movement(*known);
+        }
+
+        add(forward, initial_state(), -1, {});
+        if (mode != Mode::Forward) {
+            // 逆向搜索从所有箱子位于目标点的状态出发, 角色可能位于任意区域
+            Crates crates(board_.targets().begin(), board_.targets().end());
+            for (const auto& area : board_.regions(board_.plane(crates))) {
+                add(backward, {crates, board_.normalize(area)}, -1, {});
+            }
+        }
+
+        std::optional<std::vector<Push>> best;
+        if (cached.has_value() && mode == Mode::Forward) {
+            // 缓存的解未被证明最优, 继续搜索推动次数更少的解
+            bound_ = static_cast<int>(cached->pushes.size());
+            best = std::move(cached->pushes);
+        }
+        const auto primary = mode == Mode::Backward ? backward : forward;
+        while (!meeting_.has_value()) {
+            auto side = primary;
+            if (mode == Mode::Bidirectional
+                && searches_[backward].open.size()
+                       < searches_[forward].open.size()) {
+                side = backward;
+            }
+            auto& search = searches_[side];
+            if (search.open.empty()) {
+                // 剪枝后没有剩余的节点, 已找到的解是搜索空间中最优的
+                if (best.has_value()) {
+                    return finish(*best);
+                }
+                return std::nullopt;
+            }
+            const auto& open = searches_[primary].open;
+            const auto lower_bound =
+                open.empty() ? bound_
+                             : std::min(
+                                   static_cast<int>(
+                                       std::ceil(open.top().f / active_weight_)
+                                   ),
+                                   bound_
+                               );
+            if (should_stop(
+                    searches_[forward].open.size()
+                        + searches_[backward].open.size(),
+                    lower_bound,
+                    memory_usage()
+                )) {
+                statistics_.stopped = true;
+                if (best.has_value()) {
+                    store_cached(*best, proven_bound(lower_bound));
+                    return movement(*best);
+                }
+                return std::nullopt;
+            }
+
+            // 展开节点时的临时对象从 Arena 中分配, 每次迭代后一次性释放
+            Arena::Scope scope;
+            const auto [f, negative_g, index, h] = search.open.top();
+            search.open.pop();
+            if (-negative_g + h >= bound_) {
+                continue; // 无法得到更优的解
+            }
+            const auto state = this->state(side, index);
+            const auto entry = table_->probe(search.nodes[index].key);
+            if (entry.has_value() && static_cast<int>(entry->value) != index
+                && matches(side, entry->value, state)
+                && search.nodes[entry->value].g <= search.nodes[index].g) {
+                continue; // 已找到更短的路径
+            }
+            if (mode == Mode::Forward && is_solved(state)) {
+                best = pushes(index, -1);
+                if (active_weight_ == 1.0) {
+                    return finish(*best);
+                }
+                // 继续搜索推动次数更少的解
+                bound_ = search.nodes[index].g;
+                if (solution_callback_) {
+                    solution_callback_(movement(*best));
+                }
+                continue;
+            }
+            statistics_.expanded++;
+            if (side == forward) {
+                expand_forward(index, state);
+            } else {
+                expand_backward(index, state);
+            }
+        }
+        const auto pushes = this->pushes(meeting_->first, meeting_->second);
+        store_cached(pushes, heuristic(initial_state().crates).value_or(0));
+        return movement(pushes);
+    }
+
+    const auto& board() const noexcept {
+        return board_;
+    }
+
+    const auto& statistics() const noexcept {
+        return statistics_;
+    }
+
+    /**
+	 * @brief 获取置换表的统计, 在多次求解间累计.
+	 */
+    auto table_statistics() const noexcept -> TranspositionTable::Statistics {
+        return table_.has_value() ? table_->statistics()
+                                  : TranspositionTable::Statistics();
+    }
+
+  private:
+    static constexpr int infinity = std::numeric_limits<int>::max() / 2;
+
+    /**
+	 * @brief 搜索状态, 角色位置已规范化为可到达区域中索引最小的格子.
+	 */
+    using Crates = std::pmr::vector<uint16_t>;
+
+    struct State {
+        Crates crates; // 已排序
+        int player;
+
+        auto operator==(const State&) const -> bool = default;
+    };
+
+    /**
+	 * @brief 搜索方向.
+	 */
+    enum Side : uint8_t {
+        forward,  // 推动箱子
+        backward, // 拉动箱子
+    };
+
+    using Push = Board::Push;
+
+    /**
+	 * @brief 已知的解.
+	 */
+    struct Known {
+        std::vector<Push> pushes;
+        int bound; // 推动次数的下界
+    };
+
+    /**
+	 * @brief 从父节点到达节点的移动.
+	 *
+	 * 先沿方向连续移动箱子 length 次, 若存在宏移动则再执行宏移动中的推动.
+	 */
+    struct Move {
+        int crate = 0;                           // 移动前的箱子位置
+        int direction = 0;                       // 移动方向
+        int length = 1;                          // 沿方向移动的次数
+        const std::vector<Push>* macro = nullptr; // 目标房间中的推动
+    };
+
+    struct Node {
+        uint64_t key; // 状态的哈希值
+        int parent;   // 父节点索引, 初始节点为 -1
+        Move move;
+        int g;      // 移动次数
+        int player; // 规范化的角色位置
+    };
+
+    struct Entry {
+        int f;          // 加权的估计值
+        int negative_g; // f 相同时优先展开更深的节点
+        int index;
+        int h;
+
+        auto operator<=>(const Entry&) const = default;
+    };
+
+    struct Search {
+        std::vector<Node> nodes;
+        std::vector<uint16_t> crates; // 各节点的箱子位置, 连续存放
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> open;
+    };
+
+    /**
+	 * @brief 添加节点.
+	 *
+	 * 两个方向的搜索共享同一个置换表, 状态被另一方向访问过时即相遇.
+	 */
+    void add(Side side, State state, int parent, const Move& move) {
+        auto& search = searches_[side];
+        int g = 0;
+        if (parent != -1) {
+            g = search.nodes[parent].g + move.length
+              + (move.macro != nullptr ? static_cast<int>(move.macro->size())
+                                       : 0);
+        }
+        const auto key = hash(side, state);
+        const auto entry = table_->probe(key);
+        if (entry.has_value() && matches(side, entry->value, state)
+            && search.nodes[entry->value].g <= g) {
+            return;
+        }
+        const auto h = side == forward ? heuristic(state.crates)
+                                       : backward_heuristic(state.crates);
+        if (!h.has_value() || (side == forward && g + *h >= bound_)) {
+            return;
+        }
+
+        const int index = static_cast<int>(search.nodes.size());
+        search.nodes.push_back({key, parent, move, g, state.player});
+        search.crates.insert(
+            search.crates.end(), state.crates.begin(), state.crates.end()
+        );
+        search.open.push(
+            {static_cast<int>(g + active_weight_ * *h), -g, index, *h}
+        );
+        table_->store(
+            key,
+            static_cast<uint32_t>(index),
+            static_cast<uint16_t>(std::max(0, 0xffff - g)) // 优先保留浅层状态
+        );
+        if (table_->statistics().fill_ratio() > 0.5
+            && memory_usage() + table_->bytes() <= memory_budget_) {
+            table_->resize(table_->bytes() * 2);
+        }
+        statistics_.generated++;
+
+        const auto other = side == forward ? backward : forward;
+        if (meeting_.has_value() || searches_[other].nodes.empty()) {
+            return;
+        }
+        const auto match = table_->probe(hash(other, state));
+        if (match.has_value() && matches(other, match->value, state)) {
+            const auto other_index = static_cast<int>(match->value);
+            meeting_ = side == forward ? std::pair(index, other_index)
+                                       : std::pair(other_index, index);
+        }
+    }
+
+    /**
+	 * @brief 检查是否需要停止搜索, 并按间隔报告进度.
+	 *
+	 * @param frontier    待展开的节点数.
+	 * @param lower_bound 推动次数的下界.
+	 * @param memory      搜索占用的内存.
+	 */
+    auto should_stop(size_t frontier, int lower_bound, size_t memory) -> bool {
+        const auto now = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> elapsed = now - start_;
+        if (progress_callback_ && now - last_report_ >= progress_interval_) {
+            last_report_ = now;
+            progress_callback_({
+                statistics_.expanded,
+                frontier,
+                elapsed.count() > 0 ? statistics_.expanded / elapsed.count()
+                                    : 0.0,
+                lower_bound,
+                bound_ < infinity ? std::optional(bound_) : std::nullopt,
+                elapsed
+            });
+        }
+        return stop_.stop_requested()
+            || (node_limit_ != 0 && statistics_.expanded >= node_limit_)
+            || (time_limit_ != std::chrono::steady_clock::duration::zero()
+                && now - start_ >= time_limit_)
+            || memory > memory_budget_;
+    }
+
+    /**
+	 * @brief 获取搜索占用的内存, 包括节点, 待展开队列和置换表.
+	 */
+    auto memory_usage() const noexcept -> size_t {
+        size_t bytes = table_.has_value() ? table_->bytes() : 0;
+        for (const auto& search : searches_) {
+            bytes += search.nodes.capacity() * sizeof(Node)
+                   + search.crates.capacity() * sizeof(uint16_t)
+                   + search.open.size() * sizeof(Entry);
+        }
+        return bytes;
+    }
+
+    /**
+	 * @brief 获取节点的状态.
+	 */
+    auto state(Side side, int index) const -> State {
+        const auto& search = searches_[side];
+        const auto first =
+            search.crates.begin() + index * initial_crates_.size();
+        return {
+            {first, first + initial_crates_.size(), Arena::resource()},
+            search.nodes[index].player
+        };
+    }
+
+    /**
+	 * @brief 判断节点的状态是否与给定状态相同, 用于排除哈希冲突.
+	 */
+    auto matches(Side side, uint32_t index, const State& state) const
+        -> bool {
+        const auto& search = searches_[side];
+        if (index >= search.nodes.size()
+            || search.nodes[index].player != state.player) {
+            return false;
+        }
+        const auto first =
+            search.crates.begin() + index * initial_crates_.size();
+        return std::equal(state.crates.begin(), state.crates.end(), first);
+    }
+
+    /**
+	 * @brief 计算状态在指定搜索方向上的 Zobrist 哈希值.
+	 */
+    auto hash(Side side, const State& state) const noexcept -> uint64_t {
+        const auto cells = static_cast<size_t>(board_.cells());
+        auto key = zobrist_[cells + state.player] ^ zobrist_[cells * 2 + side];
+        for (const auto crate : state.crates) {
+            key ^= zobrist_[crate];
+        }
+        return key;
+    }
+
+    static auto splitmix64(uint64_t& seed) noexcept -> uint64_t {
+        auto z = seed += 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    /**
+	 * @brief 展开正向搜索的节点, 尝试推动每个箱子.
+	 */
+    void expand_forward(int index, const State& state) {
+        for_each_push(state, true, [&](State child, const Move& move) {
+            add(forward, std::move(child), index, move);
+        });
+    }
+
+    /**
+	 * @brief 枚举状态的所有未死锁的推动.
+	 *
+	 * @param state  状态.
+	 * @param macros 是否使用隧道和目标房间宏移动, 不使用时每次只推动一次.
+	 * @param visit  回调函数, 参数为推动后的状态和移动.
+	 */
+    template<class F>
+    void for_each_push(const State& state, bool macros, F&& visit) {
+        auto& map = map_;
+        map.resize(board_.cells());
+        for (int i = 0; i < board_.cells(); i++) {
+            map[i] = board_.tile(i);
+        }
+        for (const auto crate : state.crates) {
+            map[crate] |= Tile::Crate;
+        }
+
+        const auto area =
+            board_.reachable(state.player, board_.plane(state.crates));
+        const auto corral = find_pi_corral(state, area);
+        if (corral.has_value()) {
+            statistics_.corrals++;
+        }
+        for (size_t i = 0; i < state.crates.size(); i++) {
+            const int crate = state.crates[i];
+            for (int direction = 0; direction < 4; direction++) {
+                const auto offset = board_.offset(direction);
+                const int from = crate - offset, to = crate + offset;
+                if (!board_.contains(area, from) || !board_.is_floor(to)
+                    || (map[to] & Tile::Crate) || board_.is_dead(to)) {
+                    continue;
+                }
+                if (corral.has_value() && !board_.contains(*corral, to)) {
+                    statistics_.pruned++;
+                    continue;
+                }
+
+                map[crate] &= ~Tile::Crate;
+                map[to] |= Tile::Crate;
+                if (is_deadlocked(map, to)) {
+                    map[to] &= ~Tile::Crate;
+                    map[crate] |= Tile::Crate;
+                    continue;
+                }
+
+                // 箱子和角色均位于隧道中时, 只能继续向前推动箱子
+                Move move {crate, direction};
+                int position = to;
+                while (macros && !board_.is_target(position)
+                       && board_.is_tunnel(position, direction)
+                       && board_.is_tunnel(position - offset, direction)) {
+                    const auto next = position + offset;
+                    if (!board_.is_floor(next) || (map[next] & Tile::Crate)
+                        || board_.is_dead(next)) {
+                        break;
+                    }
+                    map[position] &= ~Tile::Crate;
+                    map[next] |= Tile::Crate;
+                    if (is_deadlocked(map, next)) {
+                        map[next] &= ~Tile::Crate;
+                        map[position] |= Tile::Crate;
+                        break;
+                    }
+                    position = next;
+                    move.length++;
+                }
+                int player = position - offset;
+
+                // 箱子到达目标房间入口时, 直接推至下一个需要填充的目标点
+                const auto* room =
+                    macros ? board_.goal_room(position, direction) : nullptr;
+                if (room != nullptr) {
+                    const auto filled = room_filled(*room, state.crates);
+                    if (filled.has_value()
+                        && *filled < static_cast<int>(room->order.size())) {
+                        move.macro = &room->paths[*filled];
+                        statistics_.macros = true;
+                        map[position] &= ~Tile::Crate;
+                        position = room->order[*filled];
+                        map[position] |= Tile::Crate;
+                        player = move.macro->back().crate;
+                    }
+                }
+                map[position] &= ~Tile::Crate;
+                map[crate] |= Tile::Crate;
+
+                Crates crates(state.crates, Arena::resource());
+                crates[i] = static_cast<uint16_t>(position);
+                std::ranges::sort(crates);
+                const auto normalized = board_.normalize(
+                    board_.reachable(player, board_.plane(crates))
+                );
+                visit(State {std::move(crates), normalized}, move);
+            }
+        }
+    }
+
+    /**
+	 * @brief 展开逆向搜索的节点, 尝试拉动每个箱子.
+	 */
+    void expand_backward(int index, const State& state) {
+        const auto plane = board_.plane(state.crates);
+        const auto area = board_.reachable(state.player, plane);
+        for (size_t i = 0; i < state.crates.size(); i++) {
+            const int crate = state.crates[i];
+            for (int direction = 0; direction < 4; direction++) {
+                // 角色位于箱子旁, 拉动箱子后退一格
+                const auto offset = board_.offset(direction);
+                const int to = crate + offset, player = to + offset;
+                if (!board_.contains(area, to) || !board_.is_floor(player)
+                    || board_.contains(plane, player)
+                    || start_min_distances_[to] == Board::unreachable) {
+                    continue;
+                }
+
+                Crates crates(state.crates, Arena::resource());
+                crates[i] = static_cast<uint16_t>(to);
+                std::ranges::sort(crates);
+                const auto normalized = board_.normalize(
+                    board_.reachable(player, board_.plane(crates))
+                );
+                add(backward,
+                    {std::move(crates), normalized},
+                    index,
+                    {crate, direction});
+            }
+        }
+    }
+
+    /**
+	 * @brief 外存广度优先搜索.
+	 *
+	 * 每层的状态经外部排序去重后存放于临时文件中, 并与已访问状态的文件归并,
+	 * 排除之前各层中出现过的状态. 找到解后从深到浅逐层扫描, 重新展开各层状态以
+	 * 找到父状态, 从而重建推动序列.
+	 */
+    auto solve_external() -> std::optional<std::string> {
+        const auto width = initial_crates_.size() + 1;
+        const TemporaryDirectory directory(
+            temporary_directory_.empty()
+                ? std::filesystem::temp_directory_path()
+                : temporary_directory_
+        );
+        const auto layer = [&](size_t depth) {
+            return directory.path() / ("layer-" + std::to_string(depth));
+        };
+        const auto visited = [&](size_t depth) {
+            return directory.path() / ("visited-" + std::to_string(depth));
+        };
+        const auto reader_memory = memory_budget_ / 8;
+        const auto sorter_memory = memory_budget_ - reader_memory;
+
+        std::vector<uint16_t> record;
+        {
+            Arena::Scope scope;
+            const auto state = initial_state();
+            if (is_solved(state)) {
+                return movement({});
+            }
+            encode(state, record);
+            RecordWriter writer(layer(0), record.size() * sizeof(uint16_t));
+            writer.write(record);
+            writer.close();
+            std::filesystem::copy_file(layer(0), visited(0));
+        }
+
+        // 找到解时记录最后一次推动及推动前的状态
+        std::optional<Push> last;
+        std::vector<uint16_t> parent;
+        size_t depth = 0, layer_size = 1;
+        for (;; depth++) {
+            ExternalSorter sorter(directory.path(), width, sorter_memory);
+            for (RecordReader reader(layer(depth), width, reader_memory);
+                 !reader.empty() && !last.has_value();
+                 reader.next()) {
+                if (should_stop(layer_size, static_cast<int>(depth), 0)) {
+                    statistics_.stopped = true;
+                    return std::nullopt;
+                }
+                Arena::Scope scope;
+                const auto state = decode(reader.current());
+                statistics_.expanded++;
+                for_each_push(state, false, [&](State child, const Move& move) {
+                    if (last.has_value() || !heuristic(child.crates)) {
+                        return;
+                    }
+                    statistics_.generated++;
+                    if (is_solved(child)) {
+                        last = Push {move.crate, move.direction};
+                        parent.assign(
+                            reader.current().begin(), reader.current().end()
+                        );
+                        return;
+                    }
+                    encode(child, record);
+                    sorter.push(record);
+                });
+            }
+            if (last.has_value()) {
+                break;
+            }
+            layer_size = sorter.merge(
+                visited(depth), layer(depth + 1), visited(depth + 1)
+            );
+            std::filesystem::remove(visited(depth));
+            if (layer_size == 0) {
+                return std::nullopt;
+            }
+        }
+
+        std::vector<Push> pushes {*last};
+        while (depth-- > 0) {
+            std::optional<Push> push;
+            for (RecordReader reader(layer(depth), width, reader_memory);
+                 !reader.empty() && !push.has_value();
+                 reader.next()) {
+                Arena::Scope scope;
+                for_each_push(
+                    decode(reader.current()),
+                    false,
+                    [&](State child, const Move& move) {
+                        encode(child, record);
+                        if (!push.has_value() && record == parent) {
+                            push = Push {move.crate, move.direction};
+                        }
+                    }
+                );
+                if (push.has_value()) {
+                    parent.assign(
+                        reader.current().begin(), reader.current().end()
+                    );
+                }
+            }
+            assert(push.has_value());
+            pushes.push_back(*push);
+        }
+        std::reverse(pushes.begin(), pushes.end());
+        return finish(pushes);
+    }
+
+    /**
+	 * @brief 将状态编码为外存搜索的记录, 依次为各箱子位置和角色位置.
+	 */
+    static void encode(const State& state, std::vector<uint16_t>& record) {
+        record.assign(state.crates.begin(), state.crates.end());
+        record.push_back(static_cast<uint16_t>(state.player));
+    }
+
+    static auto decode(std::span<const uint16_t> record) -> State {
+        return {
+            {record.begin(), record.end() - 1, Arena::resource()},
+            record.back()
+        };
+    }
+
+    /**
+	 * @brief 是否所有箱子都位于目标点上.
+	 */
+    auto is_solved(const State& state) const -> bool {
+        return std::ranges::all_of(state.crates, [&](auto crate) {
+            return board_.is_target(crate);
+        });
+    }
+
+    /**
+	 * @brief 生成从初始状态出发的推动序列.
+	 *
+	 * @param forward_index  正向搜索的节点.
+	 * @param backward_index 逆向搜索中与正向节点状态相同的节点, 仅正向搜索时
+	 *                       为 -1.
+	 */
+    auto pushes(int forward_index, int backward_index) const
+        -> std::vector<Push> {
+        std::vector<Push> pushes;
+        const auto& forward_nodes = searches_[forward].nodes;
+        for (auto i = forward_index; forward_nodes[i].parent != -1;
+             i = forward_nodes[i].parent) {
+            const auto& move = forward_nodes[i].move;
+            if (move.macro != nullptr) {
+                pushes.insert(
+                    pushes.end(), move.macro->rbegin(), move.macro->rend()
+                );
+            }
+            const auto offset = board_.offset(move.direction);
+            for (int j = move.length - 1; j >= 0; j--) {
+                pushes.push_back({move.crate + j * offset, move.direction});
+            }
+        }
+        std::reverse(pushes.begin(), pushes.end());
+
+        // 逆向搜索的拉动按相反顺序和方向执行即为推动
+        if (backward_index != -1) {
+            const auto& backward_nodes = searches_[backward].nodes;
+            for (auto i = backward_index; backward_nodes[i].parent != -1;
+                 i = backward_nodes[i].parent) {
+                const auto& move = backward_nodes[i].move;
+                pushes.push_back(
+                    {move.crate + board_.offset(move.direction),
+                     move.direction ^ 1}
+                );
+            }
+        }
+        return pushes;
+    }
+
+    /**
+	 * @brief 查找 PI 围栏 (player-inaccessible corral).
+	 *
+	 * 围栏是角色无法到达的连通空地, 与其相邻的箱子为边界箱子. 若边界箱子只能被
+	 * 推入围栏, 且角色现在就可以进行所有推入围栏的推动, 则任何解中最先移动的
+	 * 边界箱子必然是现在就可以进行的推入围栏的推动. 将其提前执行不改变推动次数,
+	 * 因此只需生成这些推动.
+	 *
+	 * @param state 状态.
+	 * @param area  角色可到达的区域.
+	 *
+	 * @return 推动数最少的 PI 围栏, 不存在时返回 std::nullopt.
+	 */
+    auto find_pi_corral(const State& state, const Bitboard& area) const
+        -> std::optional<Bitboard> {
+        std::optional<Bitboard> best;
+        int best_pushes = std::numeric_limits<int>::max();
+        for (auto& corral : board_.regions(board_.plane(state.crates))) {
+            if (board_.contains(corral, state.player)) {
+                continue;
+            }
+
+            // 围栏中的空目标点或边界上未位于目标点的箱子需要被处理,
+            // 否则解可能不需要打开围栏
+            bool needed = false;
+            corral.for_each([&](int x, int y) {
+                needed |= board_.is_target(y * board_.stride() + x);
+            });
+
+            bool valid = true;
+            int pushes = 0;
+            for (const int crate : state.crates) {
+                const auto boundary = std::ranges::any_of(
+                    std::array {0, 1, 2, 3},
+                    [&](int direction) {
+                        return board_.contains(
+                            corral, crate + board_.offset(direction)
+                        );
+                    }
+                );
+                if (!boundary) {
+                    continue;
+                }
+                needed |= !board_.is_target(crate);
+
+                for (int direction = 0; direction < 4 && valid; direction++) {
+                    const auto offset = board_.offset(direction);
+                    const int from = crate - offset, to = crate + offset;
+                    if (!board_.is_floor(from)
+                        || board_.contains(corral, from)) {
+                        continue;
+                    }
+                    if (board_.contains(corral, to)) {
+                        // 推入围栏的推动必须现在就可以进行
+                        valid = board_.contains(area, from);
+                        pushes++;
+                    } else if (board_.is_floor(to) && !board_.is_dead(to)) {
+                        // 边界箱子不能被推向围栏外
+                        valid = false;
+                    }
+                }
+                if (!valid) {
+                    break;
+                }
+            }
+            if (valid && needed && pushes < best_pushes) {
+                best_pushes = pushes;
+                best = std::move(corral);
+            }
+        }
+        return best;
+    }
+
+    /**
+	 * @brief 获取目标房间中已按顺序填充的目标点数量.
+	 *
+	 * @return 房间中的箱子未按顺序填充时返回 std::nullopt.
+	 */
+    static auto room_filled(
+        const Board::GoalRoom& room, const Crates& crates
+    ) -> std::optional<int> {
+        int count = 0;
+        for (const auto crate : crates) {
+            count += room.cells[crate];
+        }
+        if (count > static_cast<int>(room.order.size())) {
+            return std::nullopt;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!std::ranges::binary_search(crates, room.order[i])) {
+                return std::nullopt;
+            }
+        }
+        return count;
+    }
+
+    /**
+	 * @brief 从未旋转的关卡中读取初始状态.
+	 */
+    void set_initial_state(const Level& base) {
+        const auto& map = base.map();
+        initial_crates_.clear();
+        for (int i = 0; i < board_.cells(); i++) {
+            if (map[i] & Tile::Crate) {
+                initial_crates_.push_back(static_cast<uint16_t>(i));
+            }
+        }
+        const auto& player = base.player_position();
+        initial_player_ = (player.y + 1) * board_.stride() + player.x + 1;
+
+        start_distances_.clear();
+        start_min_distances_.assign(board_.cells(), Board::unreachable);
+        for (const auto crate : initial_crates_) {
+            start_distances_.push_back(board_.push_distances(crate));
+            for (int i = 0; i < board_.cells(); i++) {
+                start_min_distances_[i] = std::min(
+                    start_min_distances_[i],
+                    start_distances_.back()[i]
+                );
+            }
+        }
+    }
+
+    auto initial_state() const -> State {
+        Crates crates(
+            initial_crates_.begin(),
+            initial_crates_.end(),
+            Arena::resource()
+        );
+        std::ranges::sort(crates);
+        const auto area =
+            board_.reachable(initial_player_, board_.plane(crates));
+        return {std::move(crates), board_.normalize(area)};
+    }
+
+    /**
+	 * @brief 获取执行推动后的状态.
+	 */
+    auto apply(const State& state, const Push& push) const -> State {
+        Crates crates(state.crates, Arena::resource());
+        *std::ranges::find(crates, push.crate) =
+            static_cast<uint16_t>(push.crate + board_.offset(push.direction));
+        std::ranges::sort(crates);
+        const auto area = board_.reachable(push.crate, board_.plane(crates));
+        return {std::move(crates), board_.normalize(area)};
+    }
+
+    /**
+	 * @brief 获取状态在置换表中记录已知解的键, 与搜索节点的键互不冲突.
+	 */
+    auto solution_key(const State& state) const noexcept -> uint64_t {
+        return hash(forward, state) ^ zobrist_.back();
+    }
+
+    /**
+	 * @brief 在置换表中记录解经过的各状态及其后的推动.
+	 *
+	 * 最优解的后缀也是最优的, 因此每个条目记录的都是从该状态出发的最优解中的
+	 * 第一次推动.
+	 */
+    void remember(const std::vector<Push>& pushes) {
+        if (!table_.has_value()) {
+            return;
+        }
+        auto state = initial_state();
+        for (const auto& push : pushes) {
+            table_->store(solution_key(state), pack(push), 0xffff);
+            state = apply(state, push);
+        }
+    }
+
+    /**
+	 * @brief 从初始状态出发, 沿置换表中记录的推动到达终局.
+	 *
+	 * 每次推动都会被验证, 因此哈希冲突不会产生错误的解.
+	 *
+	 * @return 记录的推动无法到达终局时返回 std::nullopt.
+	 */
+    auto recall() -> std::optional<std::vector<Push>> {
+        auto state = initial_state();
+        std::vector<Push> pushes;
+        while (!is_solved(state)) {
+            const auto entry = table_->probe(solution_key(state));
+            if (!entry.has_value() || pushes.size() >= 0xffff) {
+                return std::nullopt;
+            }
+            const auto push = unpack(entry->value);
+            if (!is_legal(state, push)) {
+                return std::nullopt;
+            }
+            pushes.push_back(push);
+            state = apply(state, push);
+        }
+        return pushes;
+    }
+
+    /**
+	 * @brief 从解缓存中读取初始局面的解, 并验证每次推动.
+	 */
+    auto load_cached() -> std::optional<Known> {
+        if (!cache_load_) {
+            return std::nullopt;
+        }
+        auto state = initial_state();
+        const auto entry = cache_load_(hash(forward, state));
+        if (!entry.has_value() || entry->data.size() % 4 != 0) {
+            return std::nullopt;
+        }
+        Known known {{}, entry->bound};
+        for (size_t i = 0; i < entry->data.size(); i += 4) {
+            uint32_t value = 0;
+            for (size_t j = 0; j < 4; j++) {
+                value |= static_cast<uint32_t>(entry->data[i + j]) << j * 8;
+            }
+            const auto push = unpack(value);
+            if (!is_legal(state, push)) {
+                return std::nullopt;
+            }
+            known.pushes.push_back(push);
+            state = apply(state, push);
+        }
+        if (!is_solved(state)) {
+            return std::nullopt;
+        }
+        return known;
+    }
+
+    /**
+	 * @brief 将解经过的各局面及其剩余的推动写入解缓存.
+	 *
+	 * @param pushes 从初始状态出发的推动序列.
+	 * @param bound  初始状态推动次数的下界.
+	 */
+    void store_cached(const std::vector<Push>& pushes, int bound) {
+        if (!cache_store_) {
+            return;
+        }
+        std::vector<uint8_t> data;
+        for (const auto& push : pushes) {
+            const auto value = pack(push);
+            for (size_t j = 0; j < 4; j++) {
+                data.push_back(static_cast<uint8_t>(value >> j * 8));
+            }
+        }
+        std::vector<CachedSolution> entries;
+        auto state = initial_state();
+        for (size_t i = 0; i < pushes.size(); i++) {
+            const auto remaining = static_cast<int>(pushes.size() - i);
+            entries.push_back({
+                hash(forward, state),
+                remaining,
+                std::max(bound - static_cast<int>(i), 0),
+                {data.begin() + static_cast<std::ptrdiff_t>(i * 4), data.end()}
+            });
+            state = apply(state, pushes[i]);
+        }
+        cache_store_(entries);
+    }
+
+    /**
+	 * @brief 判断状态下能否进行推动.
+	 */
+    auto is_legal(const State& state, const Push& push) const -> bool {
+        if (push.direction < 0 || push.direction >= 4
+            || !std::ranges::binary_search(state.crates, push.crate)) {
+            return false;
+        }
+        const auto offset = board_.offset(push.direction);
+        const auto plane = board_.plane(state.crates);
+        return board_.contains(
+                   board_.reachable(state.player, plane), push.crate - offset
+               )
+            && board_.is_floor(push.crate + offset)
+            && !board_.contains(plane, push.crate + offset);
+    }
+
+    static auto pack(const Push& push) noexcept -> uint32_t {
+        return static_cast<uint32_t>(push.crate | push.direction << 16);
+    }
+
+    static auto unpack(uint32_t value) noexcept -> Push {
+        return {
+            static_cast<int>(value & 0xffff),
+            static_cast<int>(value >> 16)
+        };
+    }
+
+    /**
+	 * @brief 记录搜索空间中最优的解, 并生成 LURD 格式的移动.
+	 */
+    auto finish(const std::vector<Push>& pushes) -> std::string {
+        remember(pushes);
+        store_cached(pushes, proven_bound(static_cast<int>(pushes.size())));
+        return movement(pushes);
+    }
+
+    /**
+	 * @brief 获取可以写入解缓存的推动次数下界.
+	 *
+	 * 使用目标房间宏移动时搜索空间不完整, 搜索得到的下界只对宏移动成立,
+	 * 因此改用初始状态的启发值.
+	 *
+	 * @param bound 搜索得到的下界.
+	 */
+    auto proven_bound(int bound) const -> int {
+        if (!statistics_.macros) {
+            return bound;
+        }
+        return std::min(bound, heuristic(initial_state().crates).value_or(0));
+    }
+
+    /**
+	 * @brief 获取旋转回初始方向的关卡.
+	 */
+    static auto unrotated(const Level& level) -> Level {
+        Level base(level);
+        while (base.rotation() != 0) {
+            base.rotate();
+        }
+        return base;
+    }
+
+    /**
+	 * @brief 计算启发值.
+	 *
+	 * @return 推动次数的下界, 状态无解时返回 std::nullopt.
+	 */
+    auto heuristic(const Crates& crates) const -> std::optional<int> {
+        const auto matching =
+            min_cost_matching(crates, [&](size_t target, int crate) {
+                return board_.distance(target, crate);
+            });
+        if (matching >= infinity) {
+            return std::nullopt;
+        }
+        const auto estimate = pattern_database_.estimate(board_, crates);
+        if (!estimate.has_value()) {
+            return std::nullopt;
+        }
+        return std::max(matching, *estimate);
+    }
+
+    /**
+	 * @brief 计算逆向搜索的启发值, 即将箱子拉回初始位置所需拉动次数的下界.
+	 */
+    auto backward_heuristic(const Crates& crates) const -> std::optional<int> {
+        const auto matching =
+            min_cost_matching(crates, [&](size_t start, int crate) {
+                return start_distances_[start][crate];
+            });
+        if (matching >= infinity) {
+            return std::nullopt;
+        }
+        return matching;
+    }
+
+    /**
+	 * @brief 使用匈牙利算法计算箱子与目标位置的最小权完美匹配.
+	 *
+	 * @param crates   箱子位置.
+	 * @param distance 距离函数, 参数为目标位置的序号和箱子位置.
+	 */
+    template<class F>
+    auto min_cost_matching(const Crates& crates, F&& distance) const -> int {
+        const int n = static_cast<int>(crates.size());
+        const auto cost = [&](int crate, int target) -> int {
+            const auto d = distance(target, crates[crate]);
+            return d == Board::unreachable ? infinity : d;
+        };
+
+        // 下标从 1 开始, match[target] 为匹配的箱子
+        const auto resource = Arena::resource();
+        std::pmr::vector<int> u(n + 1, 0, resource), v(n + 1, 0, resource);
+        std::pmr::vector<int> match(n + 1, 0, resource);
+        std::pmr::vector<int> way(n + 1, 0, resource);
+        std::pmr::vector<int> min_value(resource);
+        std::pmr::vector<bool> used(resource);
+        for (int i = 1; i <= n; i++) {
+            match[0] = i;
+            int j0 = 0;
+            min_value.assign(n + 1, infinity);
+            used.assign(n + 1, false);
+            do {
+                used[j0] = true;
+                const int i0 = match[j0];
+                int delta = infinity, j1 = 0;
+                for (int j = 1; j <= n; j++) {
+                    if (used[j]) {
+                        continue;
+                    }
+                    const int current = cost(i0 - 1, j - 1) - u[i0] - v[j];
+                    if (current < min_value[j]) {
+                        min_value[j] = current;
+                        way[j] = j0;
+                    }
+                    if (min_value[j] < delta) {
+                        delta = min_value[j];
+                        j1 = j;
+                    }
+                }
+                if (delta >= infinity) {
+                    return infinity;
+                }
+                for (int j = 0; j <= n; j++) {
+                    if (used[j]) {
+                        u[match[j]] += delta;
+                        v[j] -= delta;
+                    } else {
+                        min_value[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while (match[j0] != 0);
+            do {
+                const int j1 = way[j0];
+                match[j0] = match[j1];
+                j0 = j1;
+            } while (j0 != 0);
+        }
+
+        int total = 0;
+        for (int j = 1; j <= n; j++) {
+            const auto c = cost(match[j] - 1, j - 1);
+            if (c >= infinity) {
+                return infinity;
+            }
+            total += c;
+        }
+        return std::min(total, infinity);
+    }
+
+    /**
+	 * @brief 检查刚被推动的箱子是否锁死.
+	 *
+	 * @param map   含箱子的地图.
+	 * @param crate 箱子位置.
+	 */
+    auto is_deadlocked(const std::vector<uint8_t>& map, int crate) const
+        -> bool {
+        // 位于目标点上的箱子即使无法移动也不一定死锁
+        const bool frozen =
+            !(map[crate] & Tile::Target)
+            && deadlock::match([&](auto tile) {
+                   constexpr deadlock::Cell c = tile;
+                   return (map[crate + c.y * board_.stride() + c.x]
+                           & deadlock::tiles(c.kind))
+                       != 0;
+               });
+        if (frozen) {
+            return true;
+        }
+
+        const auto* database = Level::deadlock_database();
+        if (database == nullptr) {
+            return false;
+        }
+        constexpr int radius = DeadlockDatabase::window_size / 2;
+        std::array<uint8_t, DeadlockDatabase::window_area> tiles;
+        auto it = tiles.begin();
+        const int x = crate % board_.stride(), y = crate / board_.stride();
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                const bool inside = x + dx >= 0 && x + dx < board_.stride()
+                                 && y + dy >= 0 && y + dy < board_.height();
+                *it++ = inside ? map[crate + dy * board_.stride() + dx]
+                               : uint8_t(Tile::Wall);
+            }
+        }
+        return database->contains(DeadlockDatabase::encode(tiles));
+    }
+
+    /**
+	 * @brief 根据搜索路径生成 LURD 格式的移动.
+	 */
+    auto movement(const std::vector<Push>& pushes) const -> std::string {
+        std::vector<uint8_t> map(board_.cells());
+        for (int i = 0; i < board_.cells(); i++) {
+            map[i] = board_.tile(i);
+        }
+        for (const auto crate : initial_crates_) {
+            map[crate] |= Tile::Crate;
+        }
+
+        std::string movement;
+        int player = initial_player_;
+        for (const auto& [crate, direction] : pushes) {
+            const auto offset = board_.offset(direction);
+            movement += walk(map, player, crate - offset);
+            movement +=
+                static_cast<char>(std::toupper(Board::moves[direction]));
+            map[crate] &= ~Tile::Crate;
+            map[crate + offset] |= Tile::Crate;
+            player = crate;
+        }
+        for (auto& move : movement) {
+            move = rotate_movement(move, rotation_);
+        }
+        return movement;
+    }
+
+    /**
+	 * @brief 通过广度优先搜索生成角色从起点走到终点的最短移动.
+	 */
+    auto walk(const std::vector<uint8_t>& map, int from, int to) const
+        -> std::string {
+        std::vector<int> came_from(board_.cells(), -1);
+        std::queue<int> queue;
+        came_from[from] = from;
+        queue.push(from);
+        while (!queue.empty() && came_from[to] == -1) {
+            const auto current = queue.front();
+            queue.pop();
+            for (int direction = 0; direction < 4; direction++) {
+                const auto next = current + board_.offset(direction);
+                if (came_from[next] != -1 || !board_.is_floor(next)
+                    || (map[next] & Tile::Crate)) {
+                    continue;
+                }
+                came_from[next] = current;
+                queue.push(next);
+            }
+        }
+        assert(came_from[to] != -1);
+
+        std::string movement;
+        for (int current = to; current != from;) {
+            const auto previous = came_from[current];
+            for (int direction = 0; direction < 4; direction++) {
+                if (previous + board_.offset(direction) == current) {
+                    movement += Board::moves[direction];
+                }
+            }
+            current = previous;
+        }
+        std::reverse(movement.begin(), movement.end());
+        return movement;
+    }
+
+    Board board_;
+    int rotation_;
+    std::vector<uint16_t> initial_crates_;
+    int initial_player_;
+    std::vector<std::vector<uint16_t>> start_distances_;
+    std::vector<uint16_t> start_min_distances_;
+    PatternDatabase pattern_database_;
+    Statistics statistics_;
+
+    std::vector<uint64_t> zobrist_;
+    size_t memory_budget_ = size_t(1) << 30;
+    std::optional<TranspositionTable> table_;
+    std::filesystem::path temporary_directory_;
+
+    size_t node_limit_ = 0;
+    std::chrono::steady_clock::duration time_limit_ {};
+    double weight_ = 1.0;
+    std::function<void(const Progress&)> progress_callback_;
+    std::chrono::steady_clock::duration progress_interval_ {};
+    std::function<void(const std::string&)> solution_callback_;
+    std::function<std::optional<CachedSolution>(uint64_t)> cache_load_;
+    std::function<void(const std::vector<CachedSolution>&)> cache_store_;
+    std::stop_token stop_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_report_;
+    double active_weight_ = 1.0; // 本次求解使用的权重
+    int bound_ = infinity;       // 已找到的最优解的推动次数
+
+    std::array<Search, 2> searches_;
+    std::optional<std::pair<int, int>> meeting_; // 相遇时两个方向的节点
+    std::vector<uint8_t> map_;
+};
@@ -0,0 +1,278 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 置换表.
+ *
+ * 以 64 位哈希值为键的开放寻址哈希表, 占用的内存由调用者指定. 每个桶包含 4 个
+ * 条目, 恰好占据一个缓存行, 桶满时按替换策略淘汰其中一个条目.
+ *
+ * 条目由校验字和数据字组成, 校验字为键与数据的异或值. 插入时通过 CAS 更新
+ * 校验字, 读取时若校验失败则视为未命中, 因此多个线程可以无锁地并发读写.
+ * 并发写入同一条目时可能丢失条目, 但不会返回错误的数据.
+ */
+class TranspositionTable {
+  public:
+    /**
+	 * @brief 替换策略.
+	 */
+    enum class Replacement {
+        Depth, // 优先淘汰深度最小的条目, 深度相同时淘汰最旧的条目
+        Age,   // 优先淘汰最旧的条目, 年龄相同时淘汰深度最小的条目
+    };
+
+    /**
+	 * @brief 条目.
+	 */
+    struct Entry {
+        uint32_t value; // 数据
+        uint16_t depth; // 条目的价值, 替换时优先保留较大者
+    };
+
+    /**
+	 * @brief 统计.
+	 */
+    struct Statistics {
+        size_t probes = 0;    // 查询次数
+        size_t hits = 0;      // 命中次数
+        size_t stores = 0;    // 写入次数
+        size_t evictions = 0; // 淘汰条目的次数
+        size_t used = 0;      // 已使用的条目数
+        size_t capacity = 0;  // 条目总数
+
+        auto hit_rate() const noexcept -> double {
+            return probes == 0 ? 0.0 : static_cast<double>(hits) / probes;
+        }
+
+        auto fill_ratio() const noexcept -> double {
+            return capacity == 0 ? 0.0 : static_cast<double>(used) / capacity;
+        }
+    };
+
+    TranspositionTable() = default;
+
+    /**
+	 * @brief 构造函数.
+	 *
+	 * @param bytes       内存预算, 桶数会向下取整为 2 的幂.
+	 * @param replacement 替换策略.
+	 */
+    explicit TranspositionTable(
+        size_t bytes, Replacement replacement = Replacement::Depth
+    ) :
+        buckets_(bucket_count(bytes)), replacement_(replacement) {}
+
+    /**
+	 * @brief 查询.
+	 *
+	 * @param key 哈希值.
+	 *
+	 * @return 未命中时返回 std::nullopt.
+	 */
+    auto probe(uint64_t key) -> std::optional<Entry> {
+        probes_.fetch_add(1, std::memory_order_relaxed);
+        for (const auto& slot : bucket(key).slots) {
+            const auto data = slot.data.load(std::memory_order_acquire);
+            if ((slot.check.load(std::memory_order_acquire) ^ data) == key
+                && data != 0) {
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return unpack(data);
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+	 * @brief 写入, 键已存在时覆盖.
+	 *
+	 * @param key   哈希值.
+	 * @param value 数据.
+	 * @param depth 条目的价值.
+	 */
+    void store(uint64_t key, uint32_t value, uint16_t depth) {
+        stores_.fetch_add(1, std::memory_order_relaxed);
+        insert(key, pack(value, depth));
+    }
+
+    /**
+	 * @brief 调整占用的内存并重新插入所有条目, 非线程安全.
+	 *
+	 * @param bytes 内存预算, 桶数会向下取整为 2 的幂.
+	 */
+    void resize(size_t bytes) {
+        const auto buckets =
+            std::exchange(buckets_, std::vector<Bucket>(bucket_count(bytes)));
+        used_.store(0, std::memory_order_relaxed);
+        for (const auto& bucket : buckets) {
+            for (const auto& slot : bucket.slots) {
+                const auto data = slot.data.load(std::memory_order_relaxed);
+                if (data != 0) {
+                    insert(slot.check.load(std::memory_order_relaxed) ^ data,
+                           data);
+                }
+            }
+        }
+    }
+
+    /**
+	 * @brief 开始新一轮搜索, 之前写入的条目将被优先淘汰.
+	 */
+    void new_generation() noexcept {
+        age_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+	 * @brief 清空, 非线程安全.
+	 */
+    void clear() {
+        for (auto& bucket : buckets_) {
+            for (auto& slot : bucket.slots) {
+                slot.check.store(0, std::memory_order_relaxed);
+                slot.data.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto* counter :
+             {&probes_, &hits_, &stores_, &evictions_, &used_}) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    auto statistics() const noexcept -> Statistics {
+        return {
+            probes_.load(std::memory_order_relaxed),
+            hits_.load(std::memory_order_relaxed),
+            stores_.load(std::memory_order_relaxed),
+            evictions_.load(std::memory_order_relaxed),
+            used_.load(std::memory_order_relaxed),
+            buckets_.size() * bucket_size
+        };
+    }
+
+    /**
+	 * @brief 获取占用的内存.
+	 */
+    auto bytes() const noexcept -> size_t {
+        return buckets_.size() * sizeof(Bucket);
+    }
+
+  private:
+    static constexpr size_t bucket_size = 4;
+
+    /**
+	 * @brief 条目, 数据字为 0 时表示空条目.
+	 */
+    struct Slot {
+        std::atomic<uint64_t> check; // 键与数据的异或值
+        std::atomic<uint64_t> data;  // 数据, 深度和年龄
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[bucket_size];
+    };
+
+    static auto bucket_count(size_t bytes) noexcept -> size_t {
+        return std::bit_floor(std::max<size_t>(bytes / sizeof(Bucket), 1));
+    }
+
+    /**
+	 * @brief 插入打包后的数据, 键已存在时覆盖.
+	 */
+    void insert(uint64_t key, uint64_t data) {
+        auto& slots = bucket(key).slots;
+        for (;;) {
+            // 依次选择相同键的条目, 空条目, 按替换策略淘汰的条目
+            Slot* victim = nullptr;
+            uint64_t expected = 0, victim_data = 0;
+            bool found = false;
+            for (auto& slot : slots) {
+                const auto old_data = slot.data.load(std::memory_order_acquire);
+                const auto check = slot.check.load(std::memory_order_acquire);
+                if ((check ^ old_data) == key && old_data != 0) {
+                    victim = &slot, expected = check, found = true;
+                    break;
+                }
+                if (victim == nullptr
+                    || (victim_data != 0
+                        && (old_data == 0 || prefer(victim_data, old_data)))) {
+                    victim = &slot, expected = check, victim_data = old_data;
+                }
+            }
+
+            if (!victim->check.compare_exchange_weak(
+                    expected,
+                    key ^ data,
+                    std::memory_order_acq_rel
+                )) {
+                continue; // 条目已被其他线程修改
+            }
+            const auto previous =
+                victim->data.exchange(data, std::memory_order_acq_rel);
+            if (previous == 0) {
+                used_.fetch_add(1, std::memory_order_relaxed);
+            } else if (!found) {
+                evictions_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+    }
+
+    /**
+	 * @brief 打包数据, 最高位置 1 以区分空条目.
+	 */
+    auto pack(uint32_t value, uint16_t depth) const noexcept -> uint64_t {
+        const uint64_t age = age_.load(std::memory_order_relaxed) & 0xff;
+        return uint64_t(1) << 63 | age << 48 | uint64_t(depth) << 32 | value;
+    }
+
+    static auto unpack(uint64_t data) noexcept -> Entry {
+        return {
+            static_cast<uint32_t>(data),
+            static_cast<uint16_t>(data >> 32)
+        };
+    }
+
+    /**
+	 * @brief 获取条目的年龄, 即其写入后经过的轮数.
+	 */
+    auto age(uint64_t data) const noexcept -> int {
+        const auto generation = age_.load(std::memory_order_relaxed);
+        return static_cast<uint8_t>(generation - (data >> 48));
+    }
+
+    /**
+	 * @brief 判断是否应优先淘汰条目 b 而不是条目 a.
+	 */
+    auto prefer(uint64_t a, uint64_t b) const noexcept -> bool {
+        const auto depth_a = unpack(a).depth, depth_b = unpack(b).depth;
+        const auto age_a = age(a), age_b = age(b);
+        if (replacement_ == Replacement::Depth) {
+            return depth_b != depth_a ? depth_b < depth_a : age_b > age_a;
+        }
+        return age_b != age_a ? age_b > age_a : depth_b < depth_a;
+    }
+
+    auto bucket(uint64_t key) noexcept -> Bucket& {
+        return buckets_[key & (buckets_.size() - 1)];
+    }
+
+    std::vector<Bucket> buckets_;
+    Replacement replacement_ = Replacement::Depth;
+    std::atomic<uint8_t> age_ = 0;
+
+    std::atomic<size_t> probes_ = 0;
+    std::atomic<size_t> hits_ = 0;
+    std::atomic<size_t> stores_ = 0;
+    std::atomic<size_t> evictions_ = 0;
+    std::atomic<size_t> used_ = 0;
+};
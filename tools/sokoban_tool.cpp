@@ -0,0 +1,349 @@
+// Copyright 2023 ShenMian
+// License(Apache-2.0)
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "database.hpp"
+#include "deadlock_database.hpp"
+#include "level.hpp"
+#include "optimizer.hpp"
+#include "pattern_database.hpp"
+#include "solver.hpp"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief 通过随机移动探索关卡, 将局部搜索证明无解的区域合并到死锁模式数据库.
+ *
+ * @param database_path 死锁模式数据库路径.
+ * @param level_paths   XSB 格式关卡文件路径.
+ */
+void learn_deadlocks(
+    const fs::path& database_path,
+    const std::vector<fs::path>& level_paths
+) {
+    constexpr int playouts = 64;
+    constexpr int moves = 1000;
+
+    std::unordered_set<uint64_t> learned, visited;
+    {
+        const DeadlockDatabase database(database_path);
+        for (const auto key : database.keys()) {
+            learned.insert(key);
+        }
+    }
+    const auto initial_size = learned.size();
+
+    std::mt19937 random(std::random_device {}());
+    for (const auto& path : level_paths) {
+        for (const auto& level : Level::load(path)) {
+            for (int i = 0; i < playouts; i++) {
+                auto copy = level;
+                for (int j = 0; j < moves; j++) {
+                    const auto move = "udlr"[random() % 4];
+                    const auto history_size = copy.history().size();
+                    copy.play(std::string(1, move));
+                    if (copy.history().size() == history_size
+                        || !std::isupper(copy.history().back())) {
+                        continue;
+                    }
+
+                    const auto crate_pos =
+                        copy.player_position() + movement_to_direction(move);
+                    if (copy.at(crate_pos) & Tile::Deadlocked) {
+                        // 已能通过死锁模式检测, 无需记录
+                        break;
+                    }
+                    const auto key = copy.deadlock_key(crate_pos);
+                    if (learned.contains(key)) {
+                        break;
+                    }
+                    if (!visited.insert(key).second) {
+                        continue;
+                    }
+                    if (DeadlockDatabase::prove(key)) {
+                        for (const auto symmetry :
+                             DeadlockDatabase::symmetries(key)) {
+                            learned.insert(symmetry);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        std::cout << path.string() << ": " << learned.size() - initial_size
+                  << " new patterns\n";
+    }
+
+    DeadlockDatabase::save(
+        database_path,
+        std::vector<uint64_t>(learned.begin(), learned.end())
+    );
+    std::cout << "Saved " << learned.size() << " patterns to "
+              << database_path.string() << '\n';
+}
+
+/**
+ * @brief 求解关卡, 并将答案和模式数据库保存至数据库.
+ *
+ * @param database_path 数据库路径.
+ * @param level_paths   XSB 格式关卡文件路径.
+ * @param mode          搜索模式.
+ */
+void solve(
+    const fs::path& database_path,
+    const std::vector<fs::path>& level_paths,
+    Solver::Mode mode
+) {
+    Database database(database_path);
+    for (const auto& path : level_paths) {
+        for (const auto& level : database.import_levels_from_file(path)) {
+            Solver solver(level);
+
+            // 模式数据库只与地图有关, 缓存后可重复使用
+            std::optional<PatternDatabase> pattern_database;
+            if (const auto data = database.get_pattern_database(level)) {
+                pattern_database =
+                    PatternDatabase::deserialize(solver.board(), *data);
+            }
+            if (!pattern_database.has_value()) {
+                pattern_database.emplace(solver.board());
+                database.update_pattern_database(
+                    level,
+                    pattern_database->serialize()
+                );
+            }
+            solver.set_pattern_database(std::move(*pattern_database));
+            solver.set_solution_cache(
+                [&](uint64_t hash) {
+                    return database.get_cached_solution(hash);
+                },
+                [&](const std::vector<CachedSolution>& entries) {
+                    database.update_solution_cache(entries);
+                }
+            );
+
+            const auto& metadata = level.metadata();
+            std::cout << (metadata.contains("title") ? metadata.at("title")
+                                                     : "Untitled")
+                      << ": ";
+            const auto solution = solver.solve(mode);
+            if (!solution.has_value()) {
+                std::cout << (solver.statistics().stopped
+                                  ? "out of memory\n"
+                                  : "no solution\n");
+                continue;
+            }
+            const auto pushes = std::ranges::count_if(*solution, [](auto c) {
+                return std::isupper(c);
+            });
+            const auto& statistics = solver.statistics();
+            const auto table = solver.table_statistics();
+            std::cout << pushes << " pushes, " << statistics.expanded
+                      << " nodes expanded, " << statistics.pruned
+                      << " pushes pruned\n";
+            if (mode != Solver::Mode::External) {
+                std::cout << "  table: " << table.hit_rate() * 100
+                          << "% hits, " << table.fill_ratio() * 100
+                          << "% full, " << table.evictions << " evictions\n";
+            }
+            std::cout << *solution << '\n';
+            database.update_level_solution(
+                database.get_level_id(level).value(),
+                *solution
+            );
+        }
+    }
+}
+
+/**
+ * @brief 并行优化数据库中所有关卡的答案, 并写回改进的答案.
+ *
+ * @param database_path 数据库路径.
+ */
+void optimize(const fs::path& database_path) {
+    Database database(database_path);
+    std::vector<std::pair<int, Level>> levels;
+    for (const auto id : database.get_solved_level_ids()) {
+        levels.emplace_back(id, database.get_level_by_id(id).value());
+    }
+
+    // 数据库只在主线程中访问, 工作线程依次领取关卡
+    std::vector<std::optional<std::string>> results(levels.size());
+    {
+        std::atomic<size_t> next = 0;
+        std::vector<std::jthread> threads;
+        const auto count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; i++) {
+            threads.emplace_back([&] {
+                for (size_t j; (j = next++) < levels.size();) {
+                    const auto& level = levels[j].second;
+                    results[j] = Optimizer(level).optimize(
+                        level.metadata().at("solution")
+                    );
+                }
+            });
+        }
+    }
+
+    const auto pushes = [](const std::string& movement) {
+        return std::ranges::count_if(movement, [](auto c) {
+            return std::isupper(c);
+        });
+    };
+    size_t improved = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        const auto& [id, level] = levels[i];
+        const auto& solution = level.metadata().at("solution");
+        if (!results[i].has_value()) {
+            std::cout << "Level " << id << ": invalid solution\n";
+            continue;
+        }
+        if (std::pair(results[i]->size(), pushes(*results[i]))
+            >= std::pair(solution.size(), pushes(solution))) {
+            continue;
+        }
+        std::cout << "Level " << id << ": " << solution.size() << '/'
+                  << pushes(solution) << " -> " << results[i]->size() << '/'
+                  << pushes(*results[i]) << " moves/pushes\n";
+        database.update_level_solution(id, *results[i]);
+        improved++;
+    }
+    std::cout << "Improved " << improved << " of " << levels.size()
+              << " solutions\n";
+}
+
+/**
+ * @brief 比较两种刷新死锁标记方式的耗时: 逐个检查箱子, 和在整个地图的位图上
+ *        匹配死锁模式.
+ *
+ * 局面由固定种子的随机移动生成, 因此多次运行的结果可以相互比较.
+ *
+ * @param level_paths XSB 格式关卡文件路径.
+ */
+void benchmark_deadlocks(const std::vector<fs::path>& level_paths) {
+    constexpr int boards_per_level = 16;
+    constexpr int moves_per_board = 16;
+    constexpr int repeats = 100;
+
+    std::mt19937 random(0);
+    std::vector<Level> boards;
+    for (const auto& path : level_paths) {
+        for (auto level : Level::load(path)) {
+            for (int i = 0; i < boards_per_level; i++) {
+                for (int j = 0; j < moves_per_board; j++) {
+                    level.play(std::string(1, "udlr"[random() % 4]));
+                }
+                boards.push_back(level);
+            }
+        }
+    }
+    if (boards.empty()) {
+        return;
+    }
+
+    // 两种方式须得到相同的死锁标记
+    size_t mismatches = 0;
+    for (auto& board : boards) {
+        board.refresh_deadlocks(false);
+        const auto expected = board.map();
+        board.refresh_deadlocks(true);
+        mismatches += board.map() != expected;
+    }
+
+    const auto measure = [&](bool bitboard) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++) {
+            for (auto& board : boards) {
+                board.refresh_deadlocks(bitboard);
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count() / static_cast<double>(repeats * boards.size());
+    };
+    const auto per_crate = measure(false);
+    const auto bitboard = measure(true);
+
+    std::cout << boards.size() << " boards, " << mismatches
+              << " mismatches\n"
+              << "  per-crate: " << per_crate << " ns/board\n"
+              << "  bitboard:  " << bitboard << " ns/board\n";
+}
+
+void print_usage() {
+    std::cout << "Usage: sokoban-tool <command> [args...]\n"
+                 "\n"
+                 "Commands:\n"
+                 "  learn-deadlocks <file.xsb>...  Learn deadlock patterns "
+                 "into deadlock.db\n"
+                 "  solve [--external] <file.xsb>...\n"
+                 "                                 Solve levels and save "
+                 "solutions to database.db,\n"
+                 "                                 --external keeps the "
+                 "search frontier on disk\n"
+                 "  optimize                       Shorten all solutions in "
+                 "database.db\n"
+                 "  bench-deadlocks <file.xsb>...  Time deadlock detection "
+                 "per crate and per board\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+    // 与游戏共用可执行文件所在目录下的数据文件
+    const auto directory =
+        fs::absolute(argv[0]).lexically_normal().parent_path();
+
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    const std::string command = argv[1];
+    const std::vector<fs::path> args(argv + 2, argv + argc);
+
+    std::optional<DeadlockDatabase> deadlock_database;
+    try {
+        if (command == "solve") {
+            // 求解时使用已学习的死锁模式剪枝, 与游戏共用同一个数据库
+            deadlock_database.emplace(directory / "deadlock.db");
+            Level::set_deadlock_database(&deadlock_database.value());
+        }
+        if (command == "learn-deadlocks" && !args.empty()) {
+            learn_deadlocks(directory / "deadlock.db", args);
+        } else if (command == "solve" && args.size() > 1
+                   && args.front() == "--external") {
+            solve(
+                directory / "database.db",
+                {args.begin() + 1, args.end()},
+                Solver::Mode::External
+            );
+        } else if (command == "solve" && !args.empty()) {
+            solve(directory / "database.db", args, Solver::Mode::Forward);
+        } else if (command == "optimize" && args.empty()) {
+            optimize(directory / "database.db");
+        } else if (command == "bench-deadlocks" && !args.empty()) {
+            benchmark_deadlocks(args);
+        } else {
+            print_usage();
+            Level::set_deadlock_database(nullptr);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        Level::set_deadlock_database(nullptr);
+        return 1;
+    }
+
+    Level::set_deadlock_database(nullptr);
+    return 0;
+}
@@ -10,3 +10,9 @@ target("gomoku")
     add_configfiles("assets/audio/*.wav", {prefixdir = "assets/audio", onlycopy = true})
     add_configfiles("assets/img/*.png", {prefixdir = "assets/img", onlycopy = true})
     add_configfiles("assets/level/*.xsb", {prefixdir = "assets/level", onlycopy = true})
+
+target("sokoban-tool")
+    set_kind("binary")
+    add_files("tools/*.cpp")
+    add_includedirs("src")
+    add_packages("sfml", "sqlitecpp")